@@ -0,0 +1,74 @@
+#include "circuit_breaker.h"
+
+#include <chrono>
+#include <mutex>
+
+namespace fantasy_ball {
+
+CircuitBreaker::CircuitBreaker(const Config &config) : config_(config) {}
+
+bool CircuitBreaker::Allow() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (state_ == State::kOpen &&
+      Clock::now() - opened_at_ >= config_.open_duration) {
+    state_ = State::kHalfOpen;
+  }
+  if (state_ == State::kClosed) {
+    return true;
+  }
+  if (state_ == State::kHalfOpen && !probing_) {
+    probing_ = true;
+    return true;
+  }
+  ++stats_.rejected;
+  return false;
+}
+
+void CircuitBreaker::RecordSuccess() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  consecutive_failures_ = 0;
+  probing_ = false;
+  state_ = State::kClosed;
+}
+
+void CircuitBreaker::RecordFailure() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  probing_ = false;
+  ++consecutive_failures_;
+  if (state_ == State::kHalfOpen ||
+      (state_ == State::kClosed &&
+       consecutive_failures_ >= config_.failure_threshold)) {
+    open(Clock::now());
+  }
+}
+
+CircuitBreaker::State CircuitBreaker::state() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return state_;
+}
+
+CircuitBreaker::Stats CircuitBreaker::GetStats() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Stats stats = stats_;
+  stats.state = state_;
+  return stats;
+}
+
+const char *CircuitBreaker::state_name(State state) {
+  switch (state) {
+  case State::kClosed:
+    return "closed";
+  case State::kOpen:
+    return "open";
+  case State::kHalfOpen:
+    return "half_open";
+  }
+  return "";
+}
+
+void CircuitBreaker::open(Clock::time_point now) {
+  state_ = State::kOpen;
+  opened_at_ = now;
+  ++stats_.opened;
+}
+} // namespace fantasy_ball
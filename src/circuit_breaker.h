@@ -0,0 +1,82 @@
+#ifndef CIRCUIT_BREAKER_H_
+#define CIRCUIT_BREAKER_H_
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+
+namespace fantasy_ball {
+
+// Stops the calls to an upstream after consecutive failures, so that callers
+// fail fast (or get cached data) instead of waiting on an upstream that is
+// down. Once the open duration passed, a single probe call is let through: its
+// success closes the circuit, its failure opens it again.
+class CircuitBreaker {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  enum class State {
+    // Calls go through.
+    kClosed,
+    // Calls are rejected.
+    kOpen,
+    // The open duration passed, a probe call decides whether to close.
+    kHalfOpen,
+  };
+
+  struct Config {
+    Config() = default;
+
+    // Consecutive failures that open the circuit. Zero disables the breaker.
+    int failure_threshold = 5;
+
+    // Time the circuit stays open before a probe call is let through.
+    std::chrono::milliseconds open_duration{10000};
+  };
+
+  struct Stats {
+    Stats() = default;
+    State state = State::kClosed;
+
+    // Times the circuit opened.
+    uint64_t opened = 0;
+
+    // Calls rejected while the circuit was open.
+    uint64_t rejected = 0;
+  };
+
+  explicit CircuitBreaker(const Config &config);
+  ~CircuitBreaker() = default;
+
+  // Returns true when a call may be made. Once the open duration passed, only
+  // returns true for a single caller until it records its result.
+  bool Allow();
+
+  void RecordSuccess();
+  void RecordFailure();
+
+  // Returns kOpen until a probe call is allowed, even if the open duration
+  // already passed.
+  State state();
+
+  Stats GetStats();
+
+  static const char *state_name(State state);
+
+private:
+  const Config config_;
+  std::mutex mutex_;
+  State state_ = State::kClosed;
+  int consecutive_failures_ = 0;
+  Clock::time_point opened_at_;
+
+  // True while the probe call of the half open circuit is in flight.
+  bool probing_ = false;
+  Stats stats_;
+
+  void open(Clock::time_point now);
+};
+
+} // namespace fantasy_ball
+
+#endif // CIRCUIT_BREAKER_H_
@@ -1,44 +1,747 @@
 #include "curl_fetch.h"
 
 #include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <ctime>
+#include <future>
 #include <memory>
+#include <mutex>
+#include <random>
 #include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
 #include "util.h"
 
 namespace fantasy_ball {
+// Bounds the allocation made ahead of the body, in case an endpoint announces
+// a bogus size.
+const size_t CurlFetch::kMaxBodyReserve = 64 * 1024 * 1024;
+const size_t CurlFetch::kLatencyWindow = 256;
+const size_t CurlFetch::kMaxTrackedConnections = 64;
+const size_t CurlFetch::kPhaseCount =
+    static_cast<size_t>(CurlFetch::Phase::kBodyBytes) + 1;
+
+const std::shared_ptr<const std::string> &CurlFetch::empty_body() {
+  static const auto *body =
+      new std::shared_ptr<const std::string>(std::make_shared<std::string>());
+  return *body;
+}
 
 CurlFetch::CurlFetch() {}
 CurlFetch::~CurlFetch() {
-  if (curl_instance_) {
-    curl_easy_cleanup(curl_instance_);
+  // The engine has to give back its handles to the pool, and the pool has to
+  // release its handles before the header list they use.
+  multi_engine_.reset();
+  handle_pool_.reset();
+  threads_.reset();
+  if (msf_header_) {
+    curl_slist_free_all(msf_header_);
   }
 }
 
-void CurlFetch::Init() {
-  // Initialize the Curl instance.
-  curl_instance_ = curl_easy_init();
-  init_curl_options(curl_instance_, &buffer_);
+bool CurlFetch::Init() { return Init(Config()); }
+
+bool CurlFetch::Init(const Config &config) {
+  config_ = config;
+  if (config_.revalidation_entries > 0) {
+    revalidation_cache_ = std::make_unique<RevalidationCache>(
+        config_.revalidation_entries, config_.revalidation_max_bytes);
+  }
+  if (config_.store_mode != StoreMode::kOff) {
+    response_store_ = std::make_unique<ResponseStore>(config_.store_directory);
+    if (!response_store_->Init()) {
+      return false;
+    }
+  }
 
   // Set the api key for the MySportsFeed endpoint.
   api_config_.msf_api_key = endpoint::read_msf_api_key();
+  msf_header_ = endpoint::make_msf_curl_header(api_config_.msf_api_key);
 
-  // TODO: Decide if we want to have this here.
-  endpoint::init_msf_curl_header(api_config_.msf_api_key, curl_instance_);
+  if (config_.pool_size > 0) {
+    // Handles are created lazily by the pool, they all get the same options
+    // and header but the buffer is set for each call.
+    handle_pool_ = std::make_unique<CurlHandlePool>(
+        config_.pool_size, [this](CURL *handle) { init_handle(handle); });
+    multi_engine_ = std::make_unique<CurlMultiEngine>(handle_pool_.get());
+    multi_engine_->Start();
+  }
+  // NOTE: Without the pool, the Curl instances are created by the threads
+  // that need one.
+  return true;
 }
 
 std::string CurlFetch::GetContent(const std::string &url) {
-  buffer_.clear();
-  curl_easy_setopt(curl_instance_, CURLOPT_URL, url.c_str());
-  curl_ret_ = curl_easy_perform(curl_instance_);
-  return buffer_;
+  return *GetResponse(url).body;
+}
+
+CurlFetch::Response CurlFetch::GetResponse(const std::string &url) {
+  Response response;
+  if (respond_without_call(url, &response)) {
+    // Served without calling the endpoint.
+  } else if (sync_calls_use_engine()) {
+    response = start_call(url).get();
+  } else {
+    response = in_flight_.Do(url, [this, &url]() {
+      auto response = perform_with_retries(url);
+      record_call(url, response);
+      return response;
+    });
+  }
+  if (handle_pool_ == nullptr) {
+    thread_state()->curl_ret = response.curl_code;
+  }
+  return response;
+}
+
+std::future<CurlFetch::Response>
+CurlFetch::GetContentAsync(const std::string &url) {
+  Response response;
+  if (multi_engine_ != nullptr && !respond_without_call(url, &response)) {
+    return start_call(url);
+  }
+  std::promise<Response> promise;
+  promise.set_value(multi_engine_ == nullptr ? GetResponse(url)
+                                             : std::move(response));
+  return promise.get_future();
+}
+
+bool CurlFetch::respond_without_call(const std::string &url,
+                                     Response *response) {
+  if (load_stored(url, response)) {
+    return true;
+  }
+  if (multi_engine_ == nullptr && CanServeStale(url) && probe_call(url)) {
+    // Without the engine there's no background refresh, this caller makes the
+    // probe call of the open circuit instead of being served stale.
+    return false;
+  }
+  return serve_stale(url, response) || reject_call(url, response);
+}
+
+bool CurlFetch::probe_call(const std::string &url) {
+  auto *breaker = circuit_breaker(url);
+  return (breaker != nullptr &&
+          breaker->state() != CircuitBreaker::State::kClosed &&
+          breaker->Allow());
+}
+
+bool CurlFetch::serve_stale(const std::string &url, Response *response) {
+  if (!CanServeStale(url)) {
+    return false;
+  }
+  auto cached = revalidation_cache_->Find(url);
+  if (cached == nullptr) {
+    return false;
+  }
+  response->curl_code = CURLE_OK;
+  response->http_code = 200;
+  response->body = cached->body;
+  response->cache_version = cached->version;
+  response->stale = true;
+
+  // Refresh the body in the background, unless a call is already in flight or
+  // the circuit doesn't allow one yet. Nobody waits on the future.
+  Response rejected;
+  if (multi_engine_ != nullptr && !in_flight_.InFlight(url) &&
+      !reject_call(url, &rejected)) {
+    start_call(url);
+  }
+  return true;
+}
+
+bool CurlFetch::CanServeStale(const std::string &url) {
+  if (!config_.serve_stale || revalidation_cache_ == nullptr) {
+    return false;
+  }
+  auto *breaker = circuit_breaker(url);
+  if ((breaker == nullptr ||
+       breaker->state() == CircuitBreaker::State::kClosed) &&
+      !in_flight_.InFlight(url)) {
+    return false;
+  }
+  return revalidation_cache_->Find(url) != nullptr;
+}
+
+bool CurlFetch::reject_call(const std::string &url, Response *response) {
+  auto *breaker = circuit_breaker(url);
+  if (breaker == nullptr || breaker->Allow()) {
+    return false;
+  }
+  response->curl_code = CURLE_COULDNT_CONNECT;
+  response->circuit_open = true;
+  return true;
+}
+
+CircuitBreaker *CurlFetch::circuit_breaker(const std::string &url) {
+  if (config_.circuit_breaker.failure_threshold <= 0) {
+    return nullptr;
+  }
+  std::lock_guard<std::mutex> lock(circuit_breakers_mutex_);
+  auto &breaker = circuit_breakers_[endpoint::endpoint_name(url)];
+  if (breaker == nullptr) {
+    breaker = std::make_unique<CircuitBreaker>(config_.circuit_breaker);
+  }
+  return breaker.get();
+}
+
+void CurlFetch::record_call(const std::string &url, const Response &response) {
+  auto *breaker = circuit_breaker(url);
+  if (breaker == nullptr) {
+    return;
+  }
+  // Only the failures that tell about the health of the endpoint count.
+  if (is_retryable(response)) {
+    breaker->RecordFailure();
+  } else {
+    breaker->RecordSuccess();
+  }
+}
+
+std::future<CurlFetch::Response>
+CurlFetch::start_call(const std::string &url) {
+  // Share the transfer of an identical call that is already in flight.
+  auto flight = in_flight_.Begin(url);
+  if (!flight.is_leader()) {
+    return std::async(std::launch::deferred,
+                      [result = flight.result]() { return result.get(); });
+  }
+
+  // The call state is shared by the callbacks of its attempts and must outlive
+  // this call.
+  auto call = std::make_shared<RetryingCall>();
+  call->url = url;
+  call->deadline = call_deadline();
+  call->flight = flight;
+  call->attempts = 1;
+  auto future = call->promise.get_future();
+  const auto now = Clock::now();
+  submit_attempt(call, false, now, reserve_token(url, now));
+  if (config_.retry.hedging) {
+    const auto p95 = GetP95Latency(url);
+    if (p95.count() > 0) {
+      const auto not_before = reserve_token(url, now + p95);
+      // No hedge when the scheduler rejects it.
+      if (not_before != Clock::time_point::max()) {
+        submit_attempt(call, true, now + p95, not_before);
+      }
+    }
+  }
+  return future;
+}
+
+void CurlFetch::submit_attempt(const std::shared_ptr<RetryingCall> &call,
+                               bool hedge, Clock::time_point queued,
+                               Clock::time_point not_before) {
+  auto transfer = std::make_shared<Transfer>();
+  transfer->url = call->url;
+  transfer->hedge = hedge;
+  transfer->queued = queued;
+  {
+    std::lock_guard<std::mutex> lock(call->mutex);
+    ++call->outstanding;
+  }
+  if (not_before == Clock::time_point::max()) {
+    // Rejected by the scheduler, it would have waited too long for a token.
+    transfer->response.curl_code = CURLE_OPERATION_TIMEDOUT;
+    complete_attempt(call, transfer.get());
+    return;
+  }
+  multi_engine_->Submit(
+      [this, call, transfer](CURL *handle) {
+        {
+          // Skip the duplicate request when the call is already answered.
+          std::lock_guard<std::mutex> lock(call->mutex);
+          if (call->done) {
+            return false;
+          }
+        }
+        transfer->timeout_ms = remaining_ms(call->deadline);
+        if (transfer->timeout_ms < 0) {
+          return false;
+        }
+        if (transfer->hedge) {
+          std::lock_guard<std::mutex> lock(retry_stats_mutex_);
+          ++retry_stats_.hedges;
+        }
+        prepare_transfer(transfer.get(), handle);
+        return true;
+      },
+      [this, call, transfer](CURL *handle, CURLcode code) {
+        if (handle == nullptr && config_.scheduler != nullptr) {
+          // Skipped before it started, its token wasn't used.
+          config_.scheduler->Refund(api_config_.msf_api_key, call->url);
+        }
+        finish_transfer(transfer.get(), handle, code);
+        complete_attempt(call, transfer.get());
+      },
+      not_before);
+}
+
+void CurlFetch::complete_attempt(const std::shared_ptr<RetryingCall> &call,
+                                 Transfer *transfer) {
+  auto &response = transfer->response;
+  const auto now = Clock::now();
+  if (response.curl_code == CURLE_ABORTED_BY_CALLBACK &&
+      now >= call->deadline) {
+    // Skipped since its deadline passed while it was queued.
+    response.curl_code = CURLE_OPERATION_TIMEDOUT;
+  }
+
+  std::unique_lock<std::mutex> lock(call->mutex);
+  --call->outstanding;
+  if (call->done) {
+    // The other request of a hedged call already answered.
+    return;
+  }
+  if (is_retryable(response)) {
+    if (call->outstanding > 0) {
+      // The duplicate request is still running, it acts as the retry.
+      return;
+    }
+    const auto backoff = retry_backoff(call->attempts);
+    if (call->attempts < config_.retry.max_attempts &&
+        now + backoff < call->deadline) {
+      ++call->attempts;
+      lock.unlock();
+      {
+        std::lock_guard<std::mutex> stats_lock(retry_stats_mutex_);
+        ++retry_stats_.retries;
+      }
+      submit_attempt(call, false, now + backoff,
+                     reserve_token(call->url, now + backoff));
+      return;
+    }
+  }
+  call->done = true;
+  lock.unlock();
+
+  {
+    std::lock_guard<std::mutex> stats_lock(retry_stats_mutex_);
+    if (transfer->hedge) {
+      ++retry_stats_.hedge_wins;
+    }
+    // NOTE: The deadline is the only timeout set on the transfers.
+    if (response.curl_code == CURLE_OPERATION_TIMEDOUT &&
+        call->deadline != Clock::time_point::max()) {
+      ++retry_stats_.deadline_exceeded;
+    }
+  }
+  record_call(call->url, response);
+  call->promise.set_value(
+      in_flight_.Finish(call->url, call->flight, std::move(response)));
+}
+
+std::vector<CurlFetch::Response>
+CurlFetch::GetContents(const std::vector<std::string> &urls) {
+  // Start every transfer before waiting on any of them.
+  std::vector<std::future<Response>> futures;
+  futures.reserve(urls.size());
+  for (const auto &url : urls) {
+    futures.push_back(GetContentAsync(url));
+  }
+  std::vector<Response> responses;
+  responses.reserve(urls.size());
+  for (auto &future : futures) {
+    responses.push_back(future.get());
+  }
+  return responses;
+}
+
+CurlFetch::Response CurlFetch::perform_with_retries(const std::string &url) {
+  const auto deadline = call_deadline();
+  Response response;
+  for (int attempt = 1;; ++attempt) {
+    const auto queued = Clock::now();
+    // Wait for the scheduler before checking out a handle, so that waiting
+    // calls don't hold on to handles.
+    const bool rejected =
+        (config_.scheduler != nullptr &&
+         !config_.scheduler->Wait(api_config_.msf_api_key, url));
+    const long timeout_ms = remaining_ms(deadline);
+    if (rejected || timeout_ms < 0) {
+      response = Response();
+      response.curl_code = CURLE_OPERATION_TIMEDOUT;
+    } else if (handle_pool_ == nullptr) {
+      response = perform(thread_handle(), url, timeout_ms, queued);
+    } else {
+      CURL *handle = handle_pool_->Acquire();
+      response = perform(handle, url, timeout_ms, queued);
+      handle_pool_->Release(handle);
+    }
+
+    if (!is_retryable(response) || attempt >= config_.retry.max_attempts) {
+      break;
+    }
+    const auto backoff = retry_backoff(attempt);
+    if (Clock::now() + backoff >= deadline) {
+      break;
+    }
+    {
+      std::lock_guard<std::mutex> lock(retry_stats_mutex_);
+      ++retry_stats_.retries;
+    }
+    std::this_thread::sleep_for(backoff);
+  }
+  // NOTE: The deadline is the only timeout set on the transfers.
+  if (response.curl_code == CURLE_OPERATION_TIMEDOUT &&
+      deadline != Clock::time_point::max()) {
+    std::lock_guard<std::mutex> lock(retry_stats_mutex_);
+    ++retry_stats_.deadline_exceeded;
+  }
+  return response;
+}
+
+CurlFetch::Response CurlFetch::perform(CURL *handle, const std::string &url,
+                                       long timeout_ms,
+                                       Clock::time_point queued) {
+  // Each call writes into its own buffer, since pooled handles may be used by
+  // several callers at once.
+  Transfer transfer;
+  transfer.url = url;
+  transfer.timeout_ms = timeout_ms;
+  transfer.queued = queued;
+  prepare_transfer(&transfer, handle);
+  CURLcode code = curl_easy_perform(handle);
+  finish_transfer(&transfer, handle, code);
+  return std::move(transfer.response);
+}
+
+CurlFetch::Transfer::~Transfer() {
+  if (headers) {
+    curl_slist_free_all(headers);
+  }
+}
+
+void CurlFetch::prepare_transfer(Transfer *transfer, CURL *handle) {
+  transfer->started = Clock::now();
+  curl_easy_setopt(handle, CURLOPT_WRITEDATA, &transfer->body);
+  curl_easy_setopt(handle, CURLOPT_HEADERDATA, transfer);
+  curl_easy_setopt(handle, CURLOPT_URL, transfer->url.c_str());
+  curl_easy_setopt(handle, CURLOPT_TIMEOUT_MS, transfer->timeout_ms);
+
+  // NOTE: The header list has to be set for every transfer, since a pooled
+  // handle may still point to the list of a previous transfer.
+  if (revalidation_cache_ != nullptr) {
+    transfer->cached = revalidation_cache_->Find(transfer->url);
+  }
+  if (transfer->cached == nullptr || !transfer->cached->has_validators()) {
+    // Nothing to revalidate, though the cached body is still used as the
+    // size hint of the response.
+    curl_easy_setopt(handle, CURLOPT_HTTPHEADER, msf_header_);
+    return;
+  }
+  for (auto *header = msf_header_; header != nullptr; header = header->next) {
+    transfer->headers = curl_slist_append(transfer->headers, header->data);
+  }
+  if (!transfer->cached->etag.empty()) {
+    const std::string if_none_match =
+        "If-None-Match: " + transfer->cached->etag;
+    transfer->headers =
+        curl_slist_append(transfer->headers, if_none_match.c_str());
+  }
+  if (!transfer->cached->last_modified.empty()) {
+    const std::string if_modified_since =
+        "If-Modified-Since: " + transfer->cached->last_modified;
+    transfer->headers =
+        curl_slist_append(transfer->headers, if_modified_since.c_str());
+  }
+  curl_easy_setopt(handle, CURLOPT_HTTPHEADER, transfer->headers);
+}
+
+void CurlFetch::finish_transfer(Transfer *transfer, CURL *handle,
+                                CURLcode code) {
+  auto &response = transfer->response;
+  response.curl_code = code;
+  response.body =
+      std::make_shared<const std::string>(std::move(transfer->body));
+  if (handle == nullptr) {
+    return;
+  }
+  curl_easy_getinfo(handle, CURLINFO_RESPONSE_CODE, &response.http_code);
+
+  // NOTE: The download size is counted by Curl before the content decoding.
+  curl_off_t wire_bytes = 0;
+  long header_bytes = 0;
+  curl_easy_getinfo(handle, CURLINFO_SIZE_DOWNLOAD_T, &wire_bytes);
+  curl_easy_getinfo(handle, CURLINFO_HEADER_SIZE, &header_bytes);
+  {
+    std::lock_guard<std::mutex> lock(endpoint_bytes_mutex_);
+    auto &bytes = endpoint_bytes_[endpoint::endpoint_name(transfer->url)];
+    ++bytes.transfers;
+    bytes.wire_bytes += wire_bytes;
+    bytes.header_bytes += header_bytes;
+    bytes.decoded_bytes += response.body->size();
+  }
+  record_timings(transfer, handle);
+
+  if (code != CURLE_OK) {
+    return;
+  }
+  record_connection(handle);
+  curl_off_t total_time = 0;
+  curl_easy_getinfo(handle, CURLINFO_TOTAL_TIME_T, &total_time);
+  {
+    std::lock_guard<std::mutex> lock(latencies_mutex_);
+    auto &latencies = latencies_[endpoint::endpoint_name(transfer->url)];
+    latencies.emplace_back(total_time);
+    if (latencies.size() > kLatencyWindow) {
+      latencies.pop_front();
+    }
+  }
+
+  if (response_store_ != nullptr && response.http_code == 200 &&
+      !response.body->empty()) {
+    // NOTE: Compressing and writing a large body would stall the other
+    // transfers of the engine, the store writes it in the background.
+    response_store_->SaveAsync(transfer->url, response.body);
+  }
+  if (revalidation_cache_ == nullptr) {
+    return;
+  }
+  if (response.http_code == 304 && transfer->cached != nullptr &&
+      transfer->cached->has_validators()) {
+    // The endpoint confirmed our copy, hand back the cached body.
+    response.not_modified = true;
+    response.body = transfer->cached->body;
+    response.cache_version = transfer->cached->version;
+    revalidation_cache_->RecordNotModified();
+  } else if (response.http_code == 200) {
+    response.cache_version = revalidation_cache_->Store(
+        transfer->url, transfer->etag, transfer->last_modified, response.body);
+  }
+}
+
+bool CurlFetch::load_stored(const std::string &url, Response *response) {
+  if (response_store_ == nullptr || config_.store_mode == StoreMode::kRecord) {
+    return false;
+  }
+  const auto start = Clock::now();
+  std::string body;
+  std::chrono::system_clock::time_point saved_at;
+  bool loaded = response_store_->Load(url, &body, &saved_at);
+  RecordTiming(url, Phase::kStore,
+               std::chrono::duration_cast<std::chrono::microseconds>(
+                   Clock::now() - start)
+                   .count());
+  if (loaded && config_.store_mode == StoreMode::kReadThrough &&
+      !stored_body_fresh(url, saved_at)) {
+    loaded = false;
+  }
+  if (loaded) {
+    response->body = std::make_shared<const std::string>(std::move(body));
+    response->curl_code = CURLE_OK;
+    response->http_code = 200;
+    response->from_store = true;
+    return true;
+  }
+  if (config_.store_mode == StoreMode::kReplay) {
+    // Never call the endpoints while replaying.
+    response->curl_code = CURLE_FILE_COULDNT_READ_FILE;
+    return true;
+  }
+  return false;
+}
+
+bool CurlFetch::stored_body_fresh(
+    const std::string &url,
+    std::chrono::system_clock::time_point saved_at) const {
+  static const std::string date_marker = "/date/";
+  const size_t position = url.find(date_marker);
+  if (position != std::string::npos) {
+    const std::string date = url.substr(position + date_marker.size(), 8);
+    if (date.size() == 8 && is_number(date)) {
+      struct tm date_start = {};
+      date_start.tm_year = std::stoi(date.substr(0, 4)) - 1900;
+      date_start.tm_mon = std::stoi(date.substr(4, 2)) - 1;
+      date_start.tm_mday = std::stoi(date.substr(6, 2));
+      const auto final_at =
+          std::chrono::system_clock::from_time_t(timegm(&date_start)) +
+          config_.store_final_after;
+      if (saved_at >= final_at) {
+        return true;
+      }
+    }
+  }
+  return std::chrono::system_clock::now() - saved_at < config_.store_ttl;
+}
+
+CurlFetch::Clock::time_point
+CurlFetch::reserve_token(const std::string &url, Clock::time_point earliest) {
+  if (config_.scheduler == nullptr) {
+    return earliest;
+  }
+  return std::max(earliest,
+                  config_.scheduler->Reserve(api_config_.msf_api_key, url));
+}
+
+CurlFetch::Clock::time_point CurlFetch::call_deadline() const {
+  if (config_.retry.deadline.count() <= 0) {
+    return Clock::time_point::max();
+  }
+  return Clock::now() + config_.retry.deadline;
+}
+
+long CurlFetch::remaining_ms(Clock::time_point deadline) {
+  if (deadline == Clock::time_point::max()) {
+    return 0;
+  }
+  const auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+      deadline - Clock::now());
+  // Zero would mean no timeout to Curl.
+  return remaining.count() > 0 ? remaining.count() : -1;
+}
+
+std::chrono::milliseconds CurlFetch::retry_backoff(int attempt) const {
+  const auto &retry = config_.retry;
+  const double backoff =
+      std::min<double>(retry.max_backoff.count(),
+                       retry.initial_backoff.count() *
+                           std::pow(retry.backoff_multiplier, attempt - 1));
+  thread_local std::mt19937 generator(std::random_device{}());
+  std::uniform_real_distribution<double> jitter(0, backoff);
+  return std::chrono::milliseconds(static_cast<int64_t>(jitter(generator)));
+}
+
+bool CurlFetch::is_retryable(const Response &response) {
+  switch (response.curl_code) {
+  case CURLE_OK:
+    return response.http_code == 429 || response.http_code >= 500;
+  case CURLE_COULDNT_RESOLVE_HOST:
+  case CURLE_COULDNT_CONNECT:
+  case CURLE_OPERATION_TIMEDOUT:
+  case CURLE_SEND_ERROR:
+  case CURLE_RECV_ERROR:
+  case CURLE_GOT_NOTHING:
+  case CURLE_PARTIAL_FILE:
+  case CURLE_SSL_CONNECT_ERROR:
+    return true;
+  default:
+    return false;
+  }
+}
+
+bool CurlFetch::sync_calls_use_engine() const {
+  // Hedged requests run concurrently on the engine, and multiplexed streams
+  // can only share the connections of the engine's multi handle.
+  return multi_engine_ != nullptr &&
+         (config_.retry.hedging || (config_.http2 && supports_http2()));
+}
+
+void CurlFetch::record_connection(CURL *handle) {
+  long http_version = 0;
+  curl_easy_getinfo(handle, CURLINFO_HTTP_VERSION, &http_version);
+#if LIBCURL_VERSION_NUM >= 0x080200
+  curl_off_t connection_id = -1;
+  curl_easy_getinfo(handle, CURLINFO_CONN_ID, &connection_id);
+#else
+  // The local port identifies the connection as long as it's open.
+  long connection_id = -1;
+  curl_easy_getinfo(handle, CURLINFO_LOCAL_PORT, &connection_id);
+#endif
+  if (connection_id < 0) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(connection_stats_mutex_);
+  auto &stats = connection_stats_[connection_id];
+  stats.http_version = http_version;
+  ++stats.streams;
+  if (connection_stats_.size() > kMaxTrackedConnections) {
+    // Forget the oldest connection (or an arbitrary one when keyed by port).
+    connection_stats_.erase(connection_stats_.begin());
+  }
+}
+
+void CurlFetch::record_timings(Transfer *transfer, CURL *handle) {
+  // The Curl timings are cumulative from the start of the transfer.
+  curl_off_t name_lookup = 0, connect = 0, app_connect = 0, start_transfer = 0,
+             total = 0;
+  long connects = 0;
+  curl_easy_getinfo(handle, CURLINFO_NAMELOOKUP_TIME_T, &name_lookup);
+  curl_easy_getinfo(handle, CURLINFO_CONNECT_TIME_T, &connect);
+  curl_easy_getinfo(handle, CURLINFO_APPCONNECT_TIME_T, &app_connect);
+  curl_easy_getinfo(handle, CURLINFO_STARTTRANSFER_TIME_T, &start_transfer);
+  curl_easy_getinfo(handle, CURLINFO_TOTAL_TIME_T, &total);
+  curl_easy_getinfo(handle, CURLINFO_NUM_CONNECTS, &connects);
+
+  std::lock_guard<std::mutex> lock(timings_mutex_);
+  auto &histograms = endpoint_timings(transfer->url);
+  auto record = [&histograms](Phase phase, int64_t value) {
+    histograms[static_cast<size_t>(phase)].Record(std::max<int64_t>(value, 0));
+  };
+  if (connects > 0) {
+    record(Phase::kDns, name_lookup);
+    record(Phase::kConnect, connect - name_lookup);
+    // Plain http connections have no handshake.
+    if (app_connect > 0) {
+      record(Phase::kTls, app_connect - connect);
+    }
+  }
+  // Transfers cut before the response started have no first byte.
+  if (start_transfer > 0) {
+    record(Phase::kFirstByte, start_transfer);
+  }
+  record(Phase::kTotal, total);
+  if (transfer->queued != Clock::time_point()) {
+    record(Phase::kQueue,
+           std::chrono::duration_cast<std::chrono::microseconds>(
+               transfer->started - transfer->queued)
+               .count());
+  }
+  if (transfer->response.curl_code == CURLE_OK) {
+    record(Phase::kBodyBytes, transfer->response.body->size());
+  }
+}
+
+void CurlFetch::init_handle(CURL *handle) {
+  init_curl_options(handle, nullptr);
+  curl_easy_setopt(handle, CURLOPT_HTTPHEADER, msf_header_);
+  if (config_.http2 && supports_http2()) {
+    // HTTP/2 for https urls only, with HTTP/1.1 as fallback when the endpoint
+    // doesn't offer it. Wait for a connection that can be multiplexed rather
+    // than opening a new one.
+    curl_easy_setopt(handle, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2TLS);
+    curl_easy_setopt(handle, CURLOPT_PIPEWAIT, 1L);
+  } else {
+    curl_easy_setopt(handle, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_1_1);
+  }
+  if (config_.compression) {
+    curl_easy_setopt(handle, CURLOPT_ACCEPT_ENCODING,
+                     accepted_encodings().c_str());
+  }
+}
+
+const std::string &CurlFetch::accepted_encodings() {
+  static const std::string encodings = [] {
+    std::string value = "gzip, deflate";
+    const auto *version = curl_version_info(CURLVERSION_NOW);
+    if (version->features & CURL_VERSION_BROTLI) {
+      value += ", br";
+    }
+    return value;
+  }();
+  return encodings;
+}
+
+bool CurlFetch::supports_http2() {
+  static const bool supported =
+      (curl_version_info(CURLVERSION_NOW)->features & CURL_VERSION_HTTP2) != 0;
+  return supported;
 }
 
 void CurlFetch::init_curl_options(CURL *curl_instance, std::string *buffer) {
-  // TODO: Add compression flag.
   curl_easy_setopt(curl_instance, CURLOPT_WRITEFUNCTION, write_callback);
   curl_easy_setopt(curl_instance, CURLOPT_WRITEDATA, buffer);
-  curl_easy_setopt(curl_instance, CURLOPT_FRESH_CONNECT, 1);
+  curl_easy_setopt(curl_instance, CURLOPT_HEADERFUNCTION, header_callback);
+  curl_easy_setopt(curl_instance, CURLOPT_HEADERDATA, nullptr);
+  // Keep the connection open between calls, so that we only pay for the TCP
+  // and TLS handshakes once per host.
+  curl_easy_setopt(curl_instance, CURLOPT_TCP_KEEPALIVE, 1L);
+  curl_easy_setopt(curl_instance, CURLOPT_NOSIGNAL, 1L);
 }
 
 size_t CurlFetch::write_callback(void *contents, size_t size, size_t nmemb,
@@ -47,9 +750,234 @@ size_t CurlFetch::write_callback(void *contents, size_t size, size_t nmemb,
   return size * nmemb;
 }
 
-CURL *CurlFetch::curl_instance() { return curl_instance_; }
+size_t CurlFetch::header_callback(char *contents, size_t size, size_t nmemb,
+                                  void *userp) {
+  auto *transfer = static_cast<Transfer *>(userp);
+  const size_t length = size * nmemb;
+  if (transfer == nullptr) {
+    return length;
+  }
+  const std::string line(contents, length);
+  if (line.compare(0, 5, "HTTP/") == 0) {
+    // Start of a new header block (e.g. after a redirect), the body size
+    // hints of the previous block don't apply anymore.
+    transfer->content_length = -1;
+    transfer->content_encoded = false;
+    return length;
+  }
+  if (line == "\r\n" || line == "\n") {
+    // End of the headers, the body comes next.
+    reserve_body(transfer);
+    return length;
+  }
+  const auto colon_pos = line.find(':');
+  if (colon_pos == std::string::npos) {
+    return length;
+  }
+  const std::string name = string_to_lower(line.substr(0, colon_pos));
+  std::string value = line.substr(colon_pos + 1);
+  value.erase(0, value.find_first_not_of(" \t"));
+  value.erase(value.find_last_not_of(" \t\r\n") + 1);
+  if (name == "etag") {
+    transfer->etag = value;
+  } else if (name == "last-modified") {
+    transfer->last_modified = value;
+  } else if (name == "content-length") {
+    transfer->content_length = std::strtoll(value.c_str(), nullptr, 10);
+  } else if (name == "content-encoding") {
+    transfer->content_encoded = (value != "identity");
+  }
+  return length;
+}
+
+void CurlFetch::reserve_body(Transfer *transfer) {
+  size_t size_hint =
+      (transfer->content_length > 0 ? transfer->content_length : 0);
+  // The Content-Length of a compressed body is its size on the wire, the
+  // decoded size is at least that. The previous body of the same url is a
+  // better guess, since the payloads of an endpoint rarely change much.
+  if (transfer->content_encoded && transfer->cached != nullptr) {
+    size_hint = std::max(size_hint, transfer->cached->body->size());
+  }
+  transfer->body.reserve(std::min(size_hint, kMaxBodyReserve));
+}
 
-CURLcode CurlFetch::curl_ret() { return curl_ret_; }
+CURL *CurlFetch::curl_instance() {
+  return (handle_pool_ == nullptr ? thread_handle() : nullptr);
+}
+
+CURLcode CurlFetch::curl_ret() {
+  return (handle_pool_ == nullptr ? thread_state()->curl_ret : CURLE_OK);
+}
+
+CurlFetch::ThreadState::~ThreadState() {
+  if (curl_instance) {
+    curl_easy_cleanup(curl_instance);
+  }
+}
+
+CurlFetch::ThreadExit::~ThreadExit() {
+  const auto thread_id = std::this_thread::get_id();
+  for (const auto &weak_states : thread_states) {
+    auto threads = weak_states.lock();
+    if (threads != nullptr) {
+      std::lock_guard<std::mutex> lock(threads->mutex);
+      threads->states.erase(thread_id);
+    }
+  }
+}
+
+CurlFetch::ThreadState *CurlFetch::thread_state() {
+  thread_local ThreadExit thread_exit;
+  // The state is only dropped by its own thread or with this class, so it
+  // stays valid once the lock is released.
+  std::lock_guard<std::mutex> lock(threads_->mutex);
+  auto &state = threads_->states[std::this_thread::get_id()];
+  if (state == nullptr) {
+    state = std::make_unique<ThreadState>();
+    auto &thread_states = thread_exit.thread_states;
+    // Forget the instances destroyed since, e.g. for a thread creating one per
+    // task.
+    thread_states.erase(
+        std::remove_if(thread_states.begin(), thread_states.end(),
+                       [](const std::weak_ptr<ThreadStates> &states) {
+                         return states.expired();
+                       }),
+        thread_states.end());
+    thread_states.push_back(threads_);
+  }
+  return state.get();
+}
+
+CURL *CurlFetch::thread_handle() {
+  auto *state = thread_state();
+  if (state->curl_instance == nullptr) {
+    state->curl_instance = curl_easy_init();
+    init_handle(state->curl_instance);
+  }
+  return state->curl_instance;
+}
+
+CurlHandlePool::Stats CurlFetch::GetPoolStats() {
+  if (handle_pool_ == nullptr) {
+    return CurlHandlePool::Stats();
+  }
+  return handle_pool_->GetStats();
+}
+
+std::unordered_map<std::string, CurlFetch::EndpointBytes>
+CurlFetch::GetEndpointBytes() {
+  std::lock_guard<std::mutex> lock(endpoint_bytes_mutex_);
+  return endpoint_bytes_;
+}
+
+RevalidationCache *CurlFetch::revalidation_cache() {
+  return revalidation_cache_.get();
+}
+
+ResponseStore *CurlFetch::response_store() { return response_store_.get(); }
+
+SingleFlight<std::string, CurlFetch::Response>::Stats
+CurlFetch::GetCoalescingStats() {
+  return in_flight_.GetStats();
+}
+
+CurlFetch::RetryStats CurlFetch::GetRetryStats() {
+  std::lock_guard<std::mutex> lock(retry_stats_mutex_);
+  return retry_stats_;
+}
+
+std::map<int64_t, CurlFetch::ConnectionStats> CurlFetch::GetConnectionStats() {
+  std::lock_guard<std::mutex> lock(connection_stats_mutex_);
+  return connection_stats_;
+}
+
+std::map<std::string, CircuitBreaker::Stats>
+CurlFetch::GetCircuitBreakerStats() {
+  std::map<std::string, CircuitBreaker::Stats> stats;
+  std::lock_guard<std::mutex> lock(circuit_breakers_mutex_);
+  for (const auto &breaker : circuit_breakers_) {
+    stats[breaker.first] = breaker.second->GetStats();
+  }
+  return stats;
+}
+
+std::chrono::microseconds CurlFetch::GetP95Latency(const std::string &url) {
+  std::vector<std::chrono::microseconds> latencies;
+  {
+    std::lock_guard<std::mutex> lock(latencies_mutex_);
+    auto it = latencies_.find(endpoint::endpoint_name(url));
+    if (it == latencies_.end() ||
+        it->second.size() < config_.retry.hedging_min_samples ||
+        it->second.empty()) {
+      return std::chrono::microseconds(0);
+    }
+    latencies.assign(it->second.begin(), it->second.end());
+  }
+  auto p95 = latencies.begin() + (latencies.size() * 95) / 100;
+  if (p95 == latencies.end()) {
+    --p95;
+  }
+  std::nth_element(latencies.begin(), p95, latencies.end());
+  return *p95;
+}
+
+void CurlFetch::RecordTiming(const std::string &url, Phase phase,
+                             uint64_t value) {
+  std::lock_guard<std::mutex> lock(timings_mutex_);
+  endpoint_timings(url)[static_cast<size_t>(phase)].Record(value);
+}
+
+std::vector<LatencyHistogram> &
+CurlFetch::endpoint_timings(const std::string &url) {
+  auto &histograms = timings_[endpoint::endpoint_name(url)];
+  if (histograms.empty()) {
+    histograms.resize(kPhaseCount);
+  }
+  return histograms;
+}
+
+std::map<std::string, std::map<std::string, LatencyHistogram::Summary>>
+CurlFetch::GetTimings() {
+  std::map<std::string, std::map<std::string, LatencyHistogram::Summary>>
+      timings;
+  std::lock_guard<std::mutex> lock(timings_mutex_);
+  for (const auto &endpoint : timings_) {
+    auto &summaries = timings[endpoint.first];
+    for (size_t i = 0; i < endpoint.second.size(); ++i) {
+      if (endpoint.second[i].count() == 0) {
+        continue;
+      }
+      summaries[phase_name(static_cast<Phase>(i))] =
+          endpoint.second[i].GetSummary();
+    }
+  }
+  return timings;
+}
+
+const char *CurlFetch::phase_name(Phase phase) {
+  switch (phase) {
+  case Phase::kDns:
+    return "dns";
+  case Phase::kConnect:
+    return "connect";
+  case Phase::kTls:
+    return "tls";
+  case Phase::kFirstByte:
+    return "first_byte";
+  case Phase::kTotal:
+    return "total";
+  case Phase::kQueue:
+    return "queue";
+  case Phase::kParse:
+    return "parse";
+  case Phase::kStore:
+    return "store";
+  case Phase::kBodyBytes:
+    return "body_bytes";
+  }
+  return "";
+}
 
 std::string CurlFetch::Key() { return api_config_.msf_api_key; }
-} // namespace fantasy_ball
\ No newline at end of file
+} // namespace fantasy_ball
@@ -1,48 +1,623 @@
 #ifndef CURL_FETCH_H_
 #define CURL_FETCH_H_
 
+#include <chrono>
+#include <cstdint>
 #include <curl/curl.h>
+#include <deque>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "circuit_breaker.h"
+#include "curl_handle_pool.h"
+#include "curl_multi_engine.h"
+#include "fetch_scheduler.h"
+#include "latency_histogram.h"
+#include "response_store.h"
+#include "revalidation_cache.h"
+#include "single_flight.h"
 
 namespace fantasy_ball {
 
 // This class will wrap a CURL object and provide useful fetching capabilities
 // to various endpoints.
+// NOTE: Thread safe once initialized. Every transfer writes into its own
+// buffer, and runs on a pooled handle or on a handle owned by the calling
+// thread, so concurrent calls neither share nor wait for a single handle.
 class CurlFetch {
 public:
+  // How the on-disk response store is used.
+  enum class StoreMode {
+    // The store isn't used.
+    kOff,
+    // Every successful response from the endpoints is written to the store.
+    kRecord,
+    // Responses only come from the store, the endpoints are never called.
+    // Urls missing from the store fail with CURLE_FILE_COULDNT_READ_FILE.
+    kReplay,
+    // Responses come from the store when present, otherwise the endpoint is
+    // called and its response recorded. Useful to warm up after a restart.
+    // Stored responses of a date that may still change are only served for
+    // a while, see Config::store_final_after.
+    kReadThrough,
+  };
+
+  using Clock = std::chrono::steady_clock;
+
+  // Phases of the endpoint calls timed by the latency histograms, all in
+  // microseconds except for the body size.
+  enum class Phase {
+    // Network phases, from the Curl timings of the transfers. The name
+    // lookup, connect and TLS handshake are only counted for the transfers
+    // that opened a new connection.
+    kDns,
+    kConnect,
+    kTls,
+    // From the start of the transfer until the first byte of the response.
+    kFirstByte,
+    kTotal,
+    // Wait for the scheduler and for a handle (or the async engine) before
+    // the transfer started.
+    kQueue,
+    // Time spent by the fetchers turning the bodies into objects.
+    kParse,
+    // Reads from the on-disk response store.
+    kStore,
+    // Decoded size of the received bodies in bytes, zero for the 304 answers.
+    kBodyBytes,
+  };
+
+  // How the calls to the endpoints are retried after a transient failure
+  // (connection errors, timeouts, 429 and 5xx answers).
+  struct RetryPolicy {
+    RetryPolicy() = default;
+
+    // Attempts made for a single call, including the first one. One disables
+    // the retries.
+    int max_attempts = 3;
+
+    // Backoff before the first retry, multiplied for every further retry up to
+    // the max backoff. The actual wait is drawn uniformly between zero and the
+    // backoff (full jitter), so that the retries of many calls don't line up.
+    std::chrono::milliseconds initial_backoff{100};
+    std::chrono::milliseconds max_backoff{2000};
+    double backoff_multiplier = 2;
+
+    // Time budget of a whole call, retries included. The transfers are cut
+    // short with CURLE_OPERATION_TIMEDOUT once it passed. Zero means no
+    // deadline.
+    std::chrono::milliseconds deadline{0};
+
+    // Sends a duplicate request when the first one takes longer than the p95
+    // latency of its endpoint, and takes whichever answers first.
+    // NOTE: Requires the connection pool, since both requests run on the
+    // async engine. The duplicate takes a token from the scheduler even when
+    // it ends up not being sent.
+    bool hedging = false;
+
+    // Latencies an endpoint needs to have recorded before its p95 is trusted
+    // for hedging.
+    size_t hedging_min_samples = 20;
+  };
+
+  struct Config {
+    Config() = default;
+
+    // Number of reusable handles kept by the connection pool. When zero, every
+    // calling thread uses a handle of its own (no pooling).
+    size_t pool_size = 0;
+
+    // Asks the endpoint for a compressed response (gzip, deflate and brotli
+    // when Curl was built with it). The body is decompressed by Curl while
+    // it is streamed into the response buffer.
+    bool compression = true;
+
+    // Negotiates HTTP/2 with the endpoints (through ALPN), so that the
+    // concurrent transfers to a host are multiplexed as streams of a single
+    // connection. Falls back to HTTP/1.1 keep-alive connections when the
+    // endpoint or the Curl library doesn't support it.
+    // NOTE: With the connection pool, synchronous calls then also go through
+    // the async engine so that they share its connections.
+    bool http2 = true;
+
+    // Number of urls for which the latest body and validators are kept, to
+    // send conditional requests (If-None-Match/If-Modified-Since) and to serve
+    // the last good body (see serve_stale), also for urls without validators.
+    // Zero disables both. Sized for the daily logs of a few seasons along
+    // with the roster and players urls, within revalidation_max_bytes.
+    size_t revalidation_entries = 4096;
+    size_t revalidation_max_bytes = 256 << 20;
+
+    StoreMode store_mode = StoreMode::kOff;
+
+    // Directory of the on-disk response store.
+    std::string store_directory = "cache/";
+
+    // In kReadThrough mode, the stored response of a date (/date/YYYYMMDD/ in
+    // the url) is served for good once it was recorded this long after the
+    // start of the date (UTC), when its games are over. Other stored
+    // responses, e.g. recorded during the date or of urls without a date, are
+    // only served while younger than store_ttl, then the endpoint is called
+    // again.
+    std::chrono::seconds store_final_after{36 * 3600};
+    std::chrono::seconds store_ttl{30};
+
+    // Bounds the rate of the requests to the endpoints, requests are delayed
+    // until the scheduler allows them. No limit when null.
+    // NOTE: This class doesn't have ownership of this object, it may be shared
+    // with other CurlFetch instances.
+    FetchScheduler *scheduler = nullptr;
+
+    RetryPolicy retry;
+
+    // Rejects the calls to an endpoint after consecutive transient failures,
+    // until a probe call succeeds. Calls to that endpoint then fail fast with
+    // CURLE_COULDNT_CONNECT.
+    CircuitBreaker::Config circuit_breaker;
+
+    // Serves the last good body of a url (from the revalidation cache, with or
+    // without validators) right away while the circuit of its endpoint isn't
+    // closed, or while a call for the url is already in flight, and refreshes
+    // it in the background.
+    // NOTE: The background refresh requires the connection pool, without it
+    // the body is refreshed by the next call that isn't served stale.
+    bool serve_stale = true;
+  };
+
+  struct RetryStats {
+    RetryStats() = default;
+
+    // Attempts made after a retryable failure.
+    uint64_t retries = 0;
+
+    // Duplicate requests sent because the first one was slower than the p95
+    // latency of its endpoint.
+    uint64_t hedges = 0;
+
+    // Calls answered by the duplicate request.
+    uint64_t hedge_wins = 0;
+
+    // Calls that failed because their deadline passed.
+    uint64_t deadline_exceeded = 0;
+  };
+
+  // Amount of data transferred for a single endpoint (e.g. games.json).
+  struct EndpointBytes {
+    EndpointBytes() = default;
+    uint64_t transfers = 0;
+
+    // Body bytes as received from the network, before decompression.
+    uint64_t wire_bytes = 0;
+
+    // Size of the response headers.
+    uint64_t header_bytes = 0;
+
+    // Body bytes after decompression, i.e. what the callers get.
+    uint64_t decoded_bytes = 0;
+  };
+
+  // Transfers carried by a single connection to an endpoint host.
+  struct ConnectionStats {
+    ConnectionStats() = default;
+
+    // HTTP version used on the connection (e.g. CURL_HTTP_VERSION_2_0).
+    long http_version = 0;
+
+    // Transfers done over the connection, as concurrent streams when it's
+    // multiplexed.
+    uint64_t streams = 0;
+  };
+
+  // Result of a single transfer.
+  struct Response {
+    Response() = default;
+
+    // Return code of the Curl transfer, anything other than CURLE_OK means the
+    // body shouldn't be used.
+    CURLcode curl_code = CURLE_OK;
+
+    // HTTP status code returned by the endpoint.
+    long http_code = 0;
+
+    // Never null. Shared with the revalidation cache, so that bodies aren't
+    // copied when cached or handed back.
+    std::shared_ptr<const std::string> body = empty_body();
+
+    // True when the endpoint answered 304 Not Modified, the body then comes
+    // from the revalidation cache.
+    bool not_modified = false;
+
+    // Version of the body in the revalidation cache, zero if not cached. Used
+    // to attach (or get back) an object parsed from the body.
+    uint64_t cache_version = 0;
+
+    // True when the body was read from the on-disk response store.
+    bool from_store = false;
+
+    // True when the body is the last good one of the url, served without
+    // waiting for the endpoint.
+    bool stale = false;
+
+    // True when the call was rejected because the circuit of the endpoint is
+    // open.
+    bool circuit_open = false;
+  };
+
   CurlFetch();
   ~CurlFetch();
 
   // Initializes internal objects, including api keys, curl instance, etc.
-  void Init();
+  // Returns false if the response store couldn't be opened.
+  bool Init();
+  bool Init(const Config &config);
 
   // Makes a Curl call to the specified url, and returns the contents.
+  // NOTE: Copies the body, GetResponse shares it instead.
   std::string GetContent(const std::string &url);
 
-  // Sets basic curl instance options, including buffer and callback, and force
-  // refresh.
+  // Same as GetContent, but returns the whole response.
+  // NOTE: Transient failures are retried according to the retry policy, the
+  // response is the one of the last attempt.
+  Response GetResponse(const std::string &url);
+
+  // Starts a transfer for the specified url without waiting for it. Transfers
+  // run concurrently on the event loop thread of the async engine.
+  // NOTE: Requires the connection pool, otherwise the transfer is done before
+  // returning and the future is already ready.
+  std::future<Response> GetContentAsync(const std::string &url);
+
+  // Fetches all the urls concurrently, and returns the responses in the same
+  // order as the urls.
+  std::vector<Response> GetContents(const std::vector<std::string> &urls);
+
+  // Sets basic curl instance options, including buffer, callback and
+  // keep-alive.
   static void init_curl_options(CURL *curl_instance, std::string *buffer);
 
-  // Returns the Curl instance initialized by this class.
+  // Returns the Curl instance initialized by this class for the calling
+  // thread.
+  // NOTE: Returns null when the connection pool is used, since handles are then
+  // checked out per call.
   CURL *curl_instance();
 
-  // Returns the latest return code from a Curl perform call.
+  // Returns the return code of the latest call made by the calling thread.
+  // NOTE: Only tracked without the connection pool, the code of each call is
+  // in its response.
   CURLcode curl_ret();
 
+  // Returns the hit/miss counts of the connection pool. All counts are zero
+  // when the pool is not used.
+  CurlHandlePool::Stats GetPoolStats();
+
+  // Returns the transferred bytes, keyed by endpoint name.
+  std::unordered_map<std::string, EndpointBytes> GetEndpointBytes();
+
+  // Returns the cache used for the conditional requests, or null if the
+  // revalidation is disabled. Fetchers can attach their parsed objects to it.
+  RevalidationCache *revalidation_cache();
+
+  // Returns the on-disk response store, or null when it isn't used.
+  ResponseStore *response_store();
+
+  // Returns how many calls to the endpoints were made, and how many calls
+  // shared the response of an identical call that was already in flight.
+  SingleFlight<std::string, Response>::Stats GetCoalescingStats();
+
+  RetryStats GetRetryStats();
+
+  // Returns the transfers done over each of the latest connections, keyed by
+  // Curl connection id (the local port with Curl older than 8.2.0).
+  std::map<int64_t, ConnectionStats> GetConnectionStats();
+
+  // Returns true when a call for the url would be served stale, i.e. its last
+  // good body is cached and the endpoint is unavailable or already being
+  // called. Fetchers use it to skip waiting on their own coalesced calls.
+  bool CanServeStale(const std::string &url);
+
+  // Returns the state of the circuit breakers, keyed by endpoint name.
+  std::map<std::string, CircuitBreaker::Stats> GetCircuitBreakerStats();
+
+  // Returns the p95 latency of the recent successful transfers to the
+  // endpoint of the url, or zero when too few were recorded.
+  std::chrono::microseconds GetP95Latency(const std::string &url);
+
+  // Adds a sample to the histogram of the phase, for the endpoint of the url.
+  // Used by the fetchers to report their parse time.
+  void RecordTiming(const std::string &url, Phase phase, uint64_t value);
+
+  // Returns the p50/p95/p99/max of every phase recorded so far, keyed by
+  // endpoint name and then by phase name (e.g. "games.json" and "first_byte").
+  std::map<std::string, std::map<std::string, LatencyHistogram::Summary>>
+  GetTimings();
+
+  static const char *phase_name(Phase phase);
+
   std::string Key();
 
 private:
+  // State of a single transfer, kept alive until the transfer completes.
+  struct Transfer {
+    Transfer() = default;
+    ~Transfer();
+    std::string url;
+    Response response;
+
+    // Buffer the body is written into, handed to the response once the
+    // transfer finished. Sized from the Content-Length of the response before
+    // it is written.
+    std::string body;
+
+    // Cached entry whose validators were sent with the request.
+    std::shared_ptr<const RevalidationCache::Entry> cached;
+
+    // Validators returned by the endpoint.
+    std::string etag;
+    std::string last_modified;
+
+    // Request headers, only set when they differ from the default ones.
+    struct curl_slist *headers = nullptr;
+
+    // Body size announced by the endpoint, -1 when unknown.
+    curl_off_t content_length = -1;
+
+    // True when the body is sent compressed, in which case the content length
+    // is the compressed size.
+    bool content_encoded = false;
+
+    // Maximum time the transfer may take, zero for no limit.
+    long timeout_ms = 0;
+
+    // True for the duplicate request of a hedged call.
+    bool hedge = false;
+
+    // When the transfer was asked for, and when it actually started.
+    Clock::time_point queued;
+    Clock::time_point started;
+  };
+
+  // State of an asynchronous call, shared by all of its attempts.
+  struct RetryingCall {
+    RetryingCall() = default;
+    std::string url;
+    Clock::time_point deadline;
+
+    // Coalesced call whose result is this call's response.
+    SingleFlight<std::string, Response>::Call flight;
+    std::promise<Response> promise;
+
+    std::mutex mutex;
+    int attempts = 0;
+
+    // Attempts (hedges included) that were submitted but didn't complete.
+    int outstanding = 0;
+    bool done = false;
+  };
+
+  static const size_t kMaxBodyReserve;
+
   struct api_config {
     std::string msf_api_key;
   } api_config_;
-  std::string buffer_;
-  CURL *curl_instance_;
-  CURLcode curl_ret_;
+  Config config_;
+
+  // State of a thread that called this class, only kept without the
+  // connection pool.
+  struct ThreadState {
+    ThreadState() = default;
+    ~ThreadState();
+
+    // Handle owned by the thread.
+    CURL *curl_instance = nullptr;
+
+    // Return code of the latest call made by the thread.
+    CURLcode curl_ret = CURLE_OK;
+  };
+
+  // NOTE: Threads only use their own state, the mutex guards the map.
+  struct ThreadStates {
+    ThreadStates() = default;
+    std::mutex mutex;
+    std::unordered_map<std::thread::id, std::unique_ptr<ThreadState>> states;
+  };
+
+  // Drops the states of a thread, and their handles, when the thread exits.
+  // Only holds weak references, the states of the threads still running are
+  // dropped when this class is destroyed.
+  struct ThreadExit {
+    ThreadExit() = default;
+    ~ThreadExit();
+    std::vector<std::weak_ptr<ThreadStates>> thread_states;
+  };
+
+  std::shared_ptr<ThreadStates> threads_ = std::make_shared<ThreadStates>();
+
+  // Authorization header shared by every handle created by this class.
+  struct curl_slist *msf_header_ = nullptr;
+
+  // Only created when the config asks for a connection pool.
+  std::unique_ptr<CurlHandlePool> handle_pool_;
+
+  // Runs the asynchronous transfers using the pooled handles. Only created
+  // along with the connection pool.
+  std::unique_ptr<CurlMultiEngine> multi_engine_;
+
+  std::unique_ptr<RevalidationCache> revalidation_cache_;
+  std::unique_ptr<ResponseStore> response_store_;
+
+  // Calls to the endpoints that are in flight, keyed by url. Identical calls
+  // made in the meantime wait for the same transfer instead of starting their
+  // own (e.g. many clients asking for the same date at tip-off).
+  SingleFlight<std::string, Response> in_flight_;
+
+  std::mutex endpoint_bytes_mutex_;
+  std::unordered_map<std::string, EndpointBytes> endpoint_bytes_;
+
+  std::mutex retry_stats_mutex_;
+  RetryStats retry_stats_;
+
+  std::mutex connection_stats_mutex_;
+  std::map<int64_t, ConnectionStats> connection_stats_;
+  static const size_t kMaxTrackedConnections;
+
+  // Latencies of the latest successful transfers, keyed by endpoint name.
+  // Used to decide when to hedge.
+  std::mutex latencies_mutex_;
+  std::unordered_map<std::string, std::deque<std::chrono::microseconds>>
+      latencies_;
+  static const size_t kLatencyWindow;
+
+  // Circuit breakers, keyed by endpoint name. Empty when they are disabled.
+  std::mutex circuit_breakers_mutex_;
+  std::unordered_map<std::string, std::unique_ptr<CircuitBreaker>>
+      circuit_breakers_;
+
+  // Histograms of the call phases, indexed by phase, keyed by endpoint name.
+  std::mutex timings_mutex_;
+  std::unordered_map<std::string, std::vector<LatencyHistogram>> timings_;
+  static const size_t kPhaseCount;
+
+  // Sets the options shared by every handle created by this class.
+  void init_handle(CURL *handle);
+
+  // Returns the state of the calling thread, created on its first call.
+  // NOTE: Only used without the connection pool.
+  ThreadState *thread_state();
+
+  // Returns the handle owned by the calling thread, created on its first
+  // call.
+  CURL *thread_handle();
+
+  // Fills the response without calling the endpoint when possible: from the
+  // on-disk store, from the last good body, or as a rejected call when the
+  // circuit is open. Returns false when the endpoint should be called.
+  bool respond_without_call(const std::string &url, Response *response);
+
+  // Fills the response with the last good body of the url when it should be
+  // served stale, and starts refreshing it.
+  bool serve_stale(const std::string &url, Response *response);
+
+  // Returns true when the circuit of the endpoint isn't closed and lets the
+  // caller make its probe call. Only the first caller once the open duration
+  // passed gets true.
+  bool probe_call(const std::string &url);
+
+  // Fills the response of a call rejected by the circuit breaker of the
+  // endpoint. Returns false when the call is allowed.
+  bool reject_call(const std::string &url, Response *response);
+
+  // Starts a call on the async engine, or joins the identical call in flight.
+  std::future<Response> start_call(const std::string &url);
+
+  // Returns the circuit breaker of the endpoint of the url, or null when they
+  // are disabled.
+  CircuitBreaker *circuit_breaker(const std::string &url);
+
+  // Reports the outcome of a call to the circuit breaker of its endpoint.
+  void record_call(const std::string &url, const Response &response);
+
+  // Does a blocking transfer on the given handle. The queue time of the
+  // transfer is counted from the given time.
+  Response perform(CURL *handle, const std::string &url, long timeout_ms,
+                   Clock::time_point queued);
+
+  // Does blocking transfers until one succeeds, fails for good, or the retry
+  // policy gives up.
+  Response perform_with_retries(const std::string &url);
+
+  // Queues an attempt of the call on the async engine, not started before the
+  // given time. The queue time of the transfer is counted from the queued
+  // time, so that the backoff and hedging delays aren't part of it. The
+  // attempt fails right away if not_before is the max time point (rejected by
+  // the scheduler). The token of an attempt that is skipped before it starts
+  // is given back to the scheduler.
+  void submit_attempt(const std::shared_ptr<RetryingCall> &call, bool hedge,
+                      Clock::time_point queued, Clock::time_point not_before);
+
+  // Either completes the call with the response of the transfer, waits for
+  // its other attempt, or submits a retry.
+  void complete_attempt(const std::shared_ptr<RetryingCall> &call,
+                        Transfer *transfer);
+
+  // Reserves a request to the url with the scheduler, if any. Returns when the
+  // request may start, not before earliest, or the max time point if the
+  // scheduler rejected it.
+  Clock::time_point reserve_token(const std::string &url,
+                                  Clock::time_point earliest);
+
+  // Returns the deadline of a call started now, or the max time point when
+  // the calls have no deadline.
+  Clock::time_point call_deadline() const;
+
+  // Returns the timeout to set on a transfer started now, zero when there is
+  // no deadline, or a negative value if the deadline already passed.
+  static long remaining_ms(Clock::time_point deadline);
+
+  // Returns the jittered wait before the retry that follows the given attempt.
+  std::chrono::milliseconds retry_backoff(int attempt) const;
+
+  // Returns true when the failure may be transient, and the call worth
+  // retrying.
+  static bool is_retryable(const Response &response);
+
+  // Sets the per transfer options on the handle.
+  void prepare_transfer(Transfer *transfer, CURL *handle);
+
+  // Fills the response from the on-disk store, when the store mode allows it.
+  // Returns false when the endpoint should be called instead.
+  bool load_stored(const std::string &url, Response *response);
+
+  // Returns true if the body stored at the given time for the url can still
+  // be served in kReadThrough mode.
+  bool stored_body_fresh(const std::string &url,
+                         std::chrono::system_clock::time_point saved_at) const;
+
+  // Fills the response once the transfer completed on the handle, and
+  // accounts for the transferred bytes.
+  void finish_transfer(Transfer *transfer, CURL *handle, CURLcode code);
+
+  // Returns true when synchronous calls have to go through the async engine,
+  // rather than doing the transfer on the calling thread.
+  bool sync_calls_use_engine() const;
+
+  // Accounts for the transfer done on the connection the handle last used.
+  void record_connection(CURL *handle);
+
+  // Records the Curl timings of the transfer done on the handle.
+  void record_timings(Transfer *transfer, CURL *handle);
+
+  // Returns the histograms of the endpoint of the url, creating them when
+  // needed. The timings mutex has to be held.
+  std::vector<LatencyHistogram> &endpoint_timings(const std::string &url);
+
+  // Returns the Accept-Encoding value listing the encodings supported by the
+  // Curl library in use.
+  static const std::string &accepted_encodings();
+
+  // Returns true when the Curl library in use was built with HTTP/2 support.
+  static bool supports_http2();
 
   static size_t write_callback(void *contents, size_t size, size_t nmemb,
                                void *userp);
+
+  // Reserves the body buffer once the headers were read, so that the body is
+  // allocated once instead of growing with every chunk written by Curl.
+  static void reserve_body(Transfer *transfer);
+
+  // Body of the responses without one, shared to avoid an allocation per
+  // response.
+  static const std::shared_ptr<const std::string> &empty_body();
+
+  // Reads the validators and the body size out of the response headers.
+  static size_t header_callback(char *contents, size_t size, size_t nmemb,
+                                void *userp);
 };
 
 } // namespace fantasy_ball
 
-#endif // CURL_FETCH_H_
\ No newline at end of file
+#endif // CURL_FETCH_H_
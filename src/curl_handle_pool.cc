@@ -0,0 +1,110 @@
+#include "curl_handle_pool.h"
+
+#include <curl/curl.h>
+#include <functional>
+#include <mutex>
+#include <utility>
+
+namespace fantasy_ball {
+
+CurlHandlePool::CurlHandlePool(size_t max_handles,
+                               std::function<void(CURL *)> init_handle)
+    : max_handles_(max_handles == 0 ? 1 : max_handles),
+      init_handle_(std::move(init_handle)) {
+  share_ = curl_share_init();
+  curl_share_setopt(share_, CURLSHOPT_LOCKFUNC, lock_share);
+  curl_share_setopt(share_, CURLSHOPT_UNLOCKFUNC, unlock_share);
+  curl_share_setopt(share_, CURLSHOPT_USERDATA, this);
+  curl_share_setopt(share_, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+  curl_share_setopt(share_, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+  // NOTE: The connection cache isn't shared, Curl doesn't support sharing it
+  // between handles that run transfers concurrently on different threads.
+  idle_handles_.reserve(max_handles_);
+}
+
+CurlHandlePool::~CurlHandlePool() {
+  // NOTE: Handles that are still checked out at this point are leaked, the
+  // share object can't be cleaned up while they are still attached to it.
+  for (CURL *handle : idle_handles_) {
+    curl_easy_cleanup(handle);
+  }
+  if (idle_handles_.size() == total_handles_) {
+    curl_share_cleanup(share_);
+  }
+}
+
+CURL *CurlHandlePool::Acquire() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  handle_released_.wait(lock, [this] {
+    return !idle_handles_.empty() || total_handles_ < max_handles_;
+  });
+  return checkout(&lock);
+}
+
+CURL *CurlHandlePool::TryAcquire() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  return checkout(&lock);
+}
+
+CURL *CurlHandlePool::checkout(std::unique_lock<std::mutex> *lock) {
+  if (!idle_handles_.empty()) {
+    CURL *handle = idle_handles_.back();
+    idle_handles_.pop_back();
+    ++stats_.hits;
+    return handle;
+  }
+  if (total_handles_ >= max_handles_) {
+    return nullptr;
+  }
+
+  // All created handles are in use but we are still under the limit, create
+  // a new one.
+  ++total_handles_;
+  ++stats_.misses;
+  lock->unlock();
+  CURL *handle = curl_easy_init();
+  curl_easy_setopt(handle, CURLOPT_SHARE, share_);
+  if (init_handle_) {
+    init_handle_(handle);
+  }
+  return handle;
+}
+
+void CurlHandlePool::Release(CURL *handle, bool performed) {
+  if (handle == nullptr) {
+    return;
+  }
+  long connects = 0;
+  curl_easy_getinfo(handle, CURLINFO_NUM_CONNECTS, &connects);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!performed) {
+      // Nothing to account for.
+    } else if (connects > 0) {
+      stats_.new_connections += connects;
+    } else {
+      ++stats_.connection_reuses;
+    }
+    idle_handles_.push_back(handle);
+  }
+  handle_released_.notify_one();
+}
+
+CurlHandlePool::Stats CurlHandlePool::GetStats() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Stats stats = stats_;
+  stats.idle_handles = idle_handles_.size();
+  stats.total_handles = total_handles_;
+  return stats;
+}
+
+void CurlHandlePool::lock_share(CURL * /*handle*/, curl_lock_data data,
+                                curl_lock_access /*access*/, void *userp) {
+  static_cast<CurlHandlePool *>(userp)->share_locks_[data].lock();
+}
+
+void CurlHandlePool::unlock_share(CURL * /*handle*/, curl_lock_data data,
+                                  void *userp) {
+  static_cast<CurlHandlePool *>(userp)->share_locks_[data].unlock();
+}
+} // namespace fantasy_ball
@@ -0,0 +1,88 @@
+#ifndef CURL_HANDLE_POOL_H_
+#define CURL_HANDLE_POOL_H_
+
+#include <array>
+#include <condition_variable>
+#include <cstdint>
+#include <curl/curl.h>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+namespace fantasy_ball {
+
+// Keeps a bounded set of reusable Curl easy handles. Every handle of the pool
+// is attached to the same CURLSH object, so the DNS cache and TLS sessions of
+// one handle can be reused by any other. Kept-alive connections stay with the
+// handle that opened them, or with the multi handle of the async engine for
+// the transfers it drives.
+class CurlHandlePool {
+public:
+  struct Stats {
+    Stats() = default;
+
+    // Checkouts that were served by an idle handle.
+    uint64_t hits = 0;
+
+    // Checkouts that had to create a new handle.
+    uint64_t misses = 0;
+
+    // Transfers that reused an already open connection.
+    uint64_t connection_reuses = 0;
+
+    // Transfers that had to open a new connection.
+    uint64_t new_connections = 0;
+
+    size_t idle_handles = 0;
+    size_t total_handles = 0;
+  };
+
+  // The init_handle callback is called once for every newly created handle and
+  // should set the options that stay the same between checkouts.
+  CurlHandlePool(size_t max_handles, std::function<void(CURL *)> init_handle);
+  ~CurlHandlePool();
+
+  CurlHandlePool(const CurlHandlePool &) = delete;
+  CurlHandlePool &operator=(const CurlHandlePool &) = delete;
+
+  // Checks out a handle. Blocks while all of the max_handles are checked out.
+  CURL *Acquire();
+
+  // Same as Acquire, but returns null instead of blocking when all handles
+  // are checked out.
+  CURL *TryAcquire();
+
+  // Returns a checked out handle to the pool.
+  // NOTE: The connection reuse is accounted for here, so performed should be
+  // false when the handle was checked out but no transfer was done with it.
+  void Release(CURL *handle, bool performed = true);
+
+  Stats GetStats();
+
+private:
+  const size_t max_handles_;
+  std::function<void(CURL *)> init_handle_;
+  CURLSH *share_;
+
+  // Curl requires the application to lock the shared data, one lock for each
+  // type of data.
+  std::array<std::mutex, CURL_LOCK_DATA_LAST> share_locks_;
+
+  std::mutex mutex_;
+  std::condition_variable handle_released_;
+  std::vector<CURL *> idle_handles_;
+  size_t total_handles_ = 0;
+  Stats stats_;
+
+  // Checks out an idle handle, or creates one when under the limit. Returns
+  // null when neither is possible.
+  CURL *checkout(std::unique_lock<std::mutex> *lock);
+
+  static void lock_share(CURL *handle, curl_lock_data data,
+                         curl_lock_access access, void *userp);
+  static void unlock_share(CURL *handle, curl_lock_data data, void *userp);
+};
+
+} // namespace fantasy_ball
+
+#endif // CURL_HANDLE_POOL_H_
@@ -0,0 +1,152 @@
+#include "curl_multi_engine.h"
+
+#include <algorithm>
+#include <chrono>
+#include <curl/curl.h>
+#include <mutex>
+#include <utility>
+
+namespace fantasy_ball {
+namespace {
+// How long the event loop waits for socket activity before checking the
+// queue again. Submit wakes the loop up, so this only matters when pending
+// transfers wait on handles checked out by synchronous callers.
+constexpr std::chrono::milliseconds kIdlePoll(1000);
+constexpr std::chrono::milliseconds kStarvedPoll(10);
+} // namespace
+
+CurlMultiEngine::CurlMultiEngine(CurlHandlePool *handle_pool)
+    : handle_pool_(handle_pool) {
+  multi_ = curl_multi_init();
+  // Transfers to the same host share a connection as HTTP/2 streams, when the
+  // connection was negotiated as HTTP/2.
+  curl_multi_setopt(multi_, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+}
+
+CurlMultiEngine::~CurlMultiEngine() {
+  Stop();
+  curl_multi_cleanup(multi_);
+}
+
+void CurlMultiEngine::Start() {
+  if (running_.exchange(true)) {
+    return;
+  }
+  loop_thread_ = std::thread(&CurlMultiEngine::run_loop, this);
+}
+
+void CurlMultiEngine::Stop() {
+  if (!running_.exchange(false)) {
+    return;
+  }
+  curl_multi_wakeup(multi_);
+  loop_thread_.join();
+  abort_all();
+}
+
+void CurlMultiEngine::Submit(SetupCallback setup, DoneCallback done,
+                             Clock::time_point not_before) {
+  if (!running_) {
+    done(nullptr, CURLE_ABORTED_BY_CALLBACK);
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_.push_back({std::move(setup), std::move(done), not_before});
+  }
+  ++in_flight_;
+  curl_multi_wakeup(multi_);
+}
+
+size_t CurlMultiEngine::InFlight() { return in_flight_; }
+
+void CurlMultiEngine::run_loop() {
+  while (running_) {
+    const auto poll_timeout = start_pending();
+    int running_transfers = 0;
+    curl_multi_perform(multi_, &running_transfers);
+    complete_transfers();
+    curl_multi_poll(multi_, nullptr, 0, poll_timeout.count(), nullptr);
+  }
+}
+
+std::chrono::milliseconds CurlMultiEngine::start_pending() {
+  auto poll_timeout = kIdlePoll;
+  const auto now = Clock::now();
+  std::unique_lock<std::mutex> lock(mutex_);
+  auto it = pending_.begin();
+  while (it != pending_.end()) {
+    if (it->not_before > now) {
+      // Not due yet, but later transfers (e.g. for other endpoints) may be.
+      poll_timeout = std::min(
+          poll_timeout, std::chrono::ceil<std::chrono::milliseconds>(
+                            it->not_before - now));
+      ++it;
+      continue;
+    }
+    CURL *handle = handle_pool_->TryAcquire();
+    if (handle == nullptr) {
+      // Every handle is busy, try again once one is released.
+      return kStarvedPoll;
+    }
+    PendingTransfer transfer = std::move(*it);
+    it = pending_.erase(it);
+    lock.unlock();
+
+    if (transfer.setup(handle)) {
+      active_[handle] = std::move(transfer.done);
+      curl_multi_add_handle(multi_, handle);
+    } else {
+      handle_pool_->Release(handle, false);
+      transfer.done(nullptr, CURLE_ABORTED_BY_CALLBACK);
+      --in_flight_;
+    }
+    // Submit may have changed the queue while it was unlocked, which
+    // invalidates the iterator.
+    lock.lock();
+    it = pending_.begin();
+  }
+  return poll_timeout;
+}
+
+void CurlMultiEngine::complete_transfers() {
+  int messages_left = 0;
+  CURLMsg *message = nullptr;
+  while ((message = curl_multi_info_read(multi_, &messages_left))) {
+    if (message->msg != CURLMSG_DONE) {
+      continue;
+    }
+    CURL *handle = message->easy_handle;
+    const CURLcode code = message->data.result;
+    curl_multi_remove_handle(multi_, handle);
+    auto it = active_.find(handle);
+    if (it != active_.end()) {
+      DoneCallback done = std::move(it->second);
+      active_.erase(it);
+      done(handle, code);
+    }
+    handle_pool_->Release(handle);
+    --in_flight_;
+  }
+}
+
+void CurlMultiEngine::abort_all() {
+  for (auto &transfer : active_) {
+    curl_multi_remove_handle(multi_, transfer.first);
+    transfer.second(transfer.first, CURLE_ABORTED_BY_CALLBACK);
+    handle_pool_->Release(transfer.first);
+    --in_flight_;
+  }
+  active_.clear();
+
+  std::deque<PendingTransfer> pending;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending.swap(pending_);
+  }
+  for (auto &transfer : pending) {
+    transfer.done(nullptr, CURLE_ABORTED_BY_CALLBACK);
+    --in_flight_;
+  }
+}
+} // namespace fantasy_ball
@@ -0,0 +1,96 @@
+#ifndef CURL_MULTI_ENGINE_H_
+#define CURL_MULTI_ENGINE_H_
+
+#include <atomic>
+#include <chrono>
+#include <curl/curl.h>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+#include "curl_handle_pool.h"
+
+namespace fantasy_ball {
+
+// Drives many Curl transfers at once on a single event loop thread, using a
+// curl_multi handle. Easy handles are checked out of a CurlHandlePool, so the
+// transfers keep reusing the pooled connections.
+class CurlMultiEngine {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  // Called on the event loop thread right before the transfer is started.
+  // Should set the per transfer options (url, buffers, etc). Returns false to
+  // skip the transfer when it isn't needed anymore (e.g. a hedged request whose
+  // original request already completed), the done callback then gets a null
+  // handle.
+  using SetupCallback = std::function<bool(CURL *handle)>;
+
+  // Called on the event loop thread once the transfer completed, before the
+  // handle goes back to the pool. The handle is null when the transfer was
+  // aborted before it started.
+  using DoneCallback = std::function<void(CURL *handle, CURLcode code)>;
+
+  // NOTE: This class doesn't have ownership of the handle pool, which should
+  // outlive the engine.
+  explicit CurlMultiEngine(CurlHandlePool *handle_pool);
+  ~CurlMultiEngine();
+
+  CurlMultiEngine(const CurlMultiEngine &) = delete;
+  CurlMultiEngine &operator=(const CurlMultiEngine &) = delete;
+
+  // Starts the event loop thread.
+  void Start();
+
+  // Stops the event loop thread. Transfers that didn't complete are aborted
+  // with CURLE_ABORTED_BY_CALLBACK.
+  void Stop();
+
+  // Queues a transfer. Never blocks, the transfer is started as soon as the
+  // pool has an idle handle, but not before the not_before time (used to
+  // respect the rate limits).
+  void Submit(SetupCallback setup, DoneCallback done,
+              Clock::time_point not_before = Clock::time_point());
+
+  // Returns the number of transfers that are either queued or running.
+  size_t InFlight();
+
+private:
+  struct PendingTransfer {
+    SetupCallback setup;
+    DoneCallback done;
+    Clock::time_point not_before;
+  };
+
+  // NOTE: This class doesn't have ownership of this object.
+  CurlHandlePool *handle_pool_;
+  CURLM *multi_;
+  std::thread loop_thread_;
+  std::atomic<bool> running_{false};
+
+  std::mutex mutex_;
+  std::deque<PendingTransfer> pending_;
+
+  // Transfers that were added to the multi handle, only touched by the event
+  // loop thread.
+  std::unordered_map<CURL *, DoneCallback> active_;
+  std::atomic<size_t> in_flight_{0};
+
+  void run_loop();
+
+  // Moves the queued transfers that are due into the multi handle, while
+  // handles are available. Returns how long the loop may wait before some
+  // queued transfer can be started.
+  std::chrono::milliseconds start_pending();
+
+  // Hands the completed transfers to their callbacks.
+  void complete_transfers();
+
+  void abort_all();
+};
+
+} // namespace fantasy_ball
+
+#endif // CURL_MULTI_ENGINE_H_
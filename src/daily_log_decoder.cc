@@ -0,0 +1,305 @@
+#include "daily_log_decoder.h"
+
+#include <cstring>
+#include <iterator>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "feed_schema.h"
+#include "json_value.h"
+
+namespace fantasy_ball {
+using PlayerLog = PlayerFetcher::PlayerLog;
+
+void DecodedDailyLog::BuildIndex() {
+  game_log_index.clear();
+  player_reference_index.clear();
+  game_log_index.reserve(game_logs.size());
+  player_reference_index.reserve(player_references.size());
+  for (size_t i = 0; i < game_logs.size(); ++i) {
+    game_log_index.emplace(game_logs[i].player_id, i);
+  }
+  for (size_t i = 0; i < player_references.size(); ++i) {
+    player_reference_index.emplace(player_references[i].id, i);
+  }
+}
+
+const size_t DailyLogDecoder::kChunkSize = 256;
+
+bool DailyLogDecoder::Decode(const std::string &content,
+                             DecodedDailyLog *decoded) {
+  return Decode(content, nullptr, decoded);
+}
+
+bool DailyLogDecoder::Decode(const std::string &content,
+                             [[maybe_unused]] ThreadPool *pool,
+                             DecodedDailyLog *decoded) {
+#ifdef FANTASY_BALL_USE_SIMDJSON
+  // simdjson validates and indexes the whole body faster than the SAX lexer
+  // can read it, the entries are then read from the parsed document.
+  JsonDocument document;
+  if (!document.Parse(content)) {
+    return false;
+  }
+  const auto root = document.root();
+  const auto game_logs = root["gamelogs"].items();
+  // Incomplete game logs (without a player id or stats) can't be joined with
+  // their player, they're dropped once every entry is read to keep the order
+  // of the response. The SAX decoder applies the same rule.
+  std::vector<PlayerLog> logs(game_logs.size());
+  std::vector<char> complete(game_logs.size(), false);
+  auto read_logs = [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      if (game_logs[i]["player"].contains("id") &&
+          game_logs[i].contains("stats")) {
+        logs[i] = PlayerLog::deserialize_json(game_logs[i]);
+        complete[i] = true;
+      }
+    }
+  };
+  if (pool == nullptr || game_logs.size() <= kChunkSize) {
+    read_logs(0, game_logs.size());
+  } else {
+    pool->ParallelFor(game_logs.size(), kChunkSize, read_logs);
+  }
+  decoded->game_logs.reserve(logs.size());
+  for (size_t i = 0; i < logs.size(); ++i) {
+    if (complete[i]) {
+      decoded->game_logs.push_back(logs[i]);
+    }
+  }
+  for (const auto &player_ref :
+       root["references"]["playerReferences"].items()) {
+    decoded->player_references.push_back(
+        PlayerFetcher::PlayerIdentity::deserialize_json(player_ref));
+  }
+#else
+  DailyLogDecoder decoder(decoded);
+  if (!nlohmann::json::sax_parse(content, &decoder)) {
+    return false;
+  }
+#endif
+  decoded->BuildIndex();
+  return true;
+}
+
+DailyLogDecoder::DailyLogDecoder(DecodedDailyLog *decoded)
+    : decoded_(decoded) {}
+
+bool DailyLogDecoder::null() { return true; }
+
+bool DailyLogDecoder::boolean(bool /*value*/) { return true; }
+
+bool DailyLogDecoder::number_integer(number_integer_t value) {
+  number(static_cast<double>(value));
+  return true;
+}
+
+bool DailyLogDecoder::number_unsigned(number_unsigned_t value) {
+  number(static_cast<double>(value));
+  return true;
+}
+
+bool DailyLogDecoder::number_float(number_float_t value,
+                                   const string_t & /*text*/) {
+  number(value);
+  return true;
+}
+
+bool DailyLogDecoder::string(string_t &value) {
+  if (current() != Context::kPlayerReference) {
+    return true;
+  }
+  auto &player = decoded_->player_references.back();
+  if (key_ == "firstName") {
+    player.first_name = value;
+  } else if (key_ == "lastName") {
+    player.last_name = value;
+  } else if (key_ == "primaryPosition") {
+    player.position = value;
+  } else if (key_ == "officialImageSrc") {
+    player.img_url = std::move(value);
+  }
+  return true;
+}
+
+bool DailyLogDecoder::binary(binary_t & /*value*/) { return true; }
+
+bool DailyLogDecoder::start_object(std::size_t /*elements*/) {
+  const Context context = child_context(false);
+  if (context == Context::kGameLog) {
+    decoded_->game_logs.emplace_back();
+    has_player_id_ = false;
+    has_stats_ = false;
+  } else if (context == Context::kPlayerReference) {
+    decoded_->player_references.emplace_back();
+  } else if (context == Context::kStats) {
+    has_stats_ = true;
+  }
+  if (context == Context::kGame || context == Context::kPlayer ||
+      context == Context::kStatGroup) {
+    resolve_fields(context);
+  }
+  contexts_.push_back(context);
+  return true;
+}
+
+bool DailyLogDecoder::key(string_t &value) {
+  key_.swap(value);
+  field_ = -1;
+  const Context context = current();
+  if (context != Context::kGame && context != Context::kPlayer &&
+      context != Context::kStatGroup) {
+    return true;
+  }
+  for (int i = fields_begin_; i < fields_end_; ++i) {
+    if (key_ == feed_schema::kPlayerLogFields[i].name) {
+      field_ = i;
+      break;
+    }
+  }
+  return true;
+}
+
+bool DailyLogDecoder::end_object() {
+  if (current() == Context::kGameLog && (!has_player_id_ || !has_stats_)) {
+    // Incomplete game logs can't be joined with their player.
+    decoded_->game_logs.pop_back();
+  }
+  contexts_.pop_back();
+  return true;
+}
+
+bool DailyLogDecoder::start_array(std::size_t /*elements*/) {
+  contexts_.push_back(child_context(true));
+  return true;
+}
+
+bool DailyLogDecoder::end_array() {
+  contexts_.pop_back();
+  return true;
+}
+
+bool DailyLogDecoder::parse_error(
+    std::size_t /*position*/, const std::string & /*last_token*/,
+    const nlohmann::detail::exception & /*error*/) {
+  return false;
+}
+
+DailyLogDecoder::Context DailyLogDecoder::current() const {
+  return (contexts_.empty() ? Context::kSkipped : contexts_.back());
+}
+
+DailyLogDecoder::Context DailyLogDecoder::child_context(bool is_array) const {
+  if (contexts_.empty()) {
+    return (is_array ? Context::kSkipped : Context::kRoot);
+  }
+  switch (contexts_.back()) {
+  case Context::kRoot:
+    if (is_array && key_ == "gamelogs") {
+      return Context::kGameLogs;
+    }
+    if (!is_array && key_ == "references") {
+      return Context::kReferences;
+    }
+    break;
+  case Context::kGameLogs:
+    if (!is_array) {
+      return Context::kGameLog;
+    }
+    break;
+  case Context::kGameLog:
+    if (is_array) {
+      break;
+    }
+    if (key_ == "game") {
+      return Context::kGame;
+    }
+    if (key_ == "player") {
+      return Context::kPlayer;
+    }
+    if (key_ == "stats") {
+      return Context::kStats;
+    }
+    break;
+  case Context::kStats:
+    if (!is_array) {
+      return Context::kStatGroup;
+    }
+    break;
+  case Context::kReferences:
+    if (is_array && key_ == "playerReferences") {
+      return Context::kPlayerReferences;
+    }
+    break;
+  case Context::kPlayerReferences:
+    if (!is_array) {
+      return Context::kPlayerReference;
+    }
+    break;
+  default:
+    break;
+  }
+  return Context::kSkipped;
+}
+
+void DailyLogDecoder::resolve_fields(Context context) {
+  const char *object = "stats";
+  const char *nested_object = nullptr;
+  if (context == Context::kGame) {
+    object = "game";
+  } else if (context == Context::kPlayer) {
+    object = "player";
+  } else {
+    // The key of a stats category is its name.
+    nested_object = key_.c_str();
+  }
+  // The paths of an object are next to each other in the table.
+  fields_begin_ = 0;
+  fields_end_ = 0;
+  const int size = static_cast<int>(std::size(feed_schema::kPlayerLogFields));
+  for (int i = 0; i < size; ++i) {
+    const auto &field = feed_schema::kPlayerLogFields[i];
+    const bool same_object =
+        std::strcmp(field.object, object) == 0 &&
+        (field.nested_object == nullptr) == (nested_object == nullptr) &&
+        (nested_object == nullptr ||
+         std::strcmp(field.nested_object, nested_object) == 0);
+    if (same_object) {
+      if (fields_end_ == fields_begin_) {
+        fields_begin_ = i;
+      }
+      fields_end_ = i + 1;
+    } else if (fields_end_ > fields_begin_) {
+      break;
+    }
+  }
+}
+
+void DailyLogDecoder::number(double value) {
+  const Context context = current();
+  if (context == Context::kPlayerReference) {
+    if (key_ == "id") {
+      decoded_->player_references.back().id = static_cast<int>(value);
+    }
+    return;
+  }
+  if (field_ < 0 || (context != Context::kGame &&
+                     context != Context::kPlayer &&
+                     context != Context::kStatGroup)) {
+    return;
+  }
+  const auto &field = feed_schema::kPlayerLogFields[field_];
+  auto &log = decoded_->game_logs.back();
+  if (field.int_member != nullptr) {
+    log.*field.int_member = static_cast<int>(value);
+    if (field.int_member == &PlayerLog::player_id) {
+      has_player_id_ = true;
+    }
+  } else if (field.float_member != nullptr) {
+    log.*field.float_member = static_cast<float>(value);
+  }
+}
+} // namespace fantasy_ball
@@ -0,0 +1,131 @@
+#ifndef DAILY_LOG_DECODER_H_
+#define DAILY_LOG_DECODER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "player_fetcher.h"
+#include "thread_pool.h"
+
+namespace fantasy_ball {
+
+// Game logs and player references of a daily player log endpoint response.
+struct DecodedDailyLog {
+  DecodedDailyLog() = default;
+
+  // Game logs with a player id, in the order of the response.
+  std::vector<PlayerFetcher::PlayerLog> game_logs;
+
+  std::vector<PlayerFetcher::PlayerIdentity> player_references;
+
+  // Positions of the game logs and player references, keyed by player id, so
+  // that joining a log with its player doesn't scan every reference.
+  std::unordered_map<int, size_t> game_log_index;
+  std::unordered_map<int, size_t> player_reference_index;
+
+  // Fills the indexes from the decoded entries. When a player id is repeated,
+  // the first entry is kept.
+  void BuildIndex();
+};
+
+// Streaming decoder of the player_gamelogs.json responses. The parser events
+// are written straight into the player structs, in a single pass over the
+// body and without building the json document. Anything outside of the
+// gamelogs and references.playerReferences arrays is skipped.
+// NOTE: When built with FANTASY_BALL_USE_SIMDJSON, Decode reads the body with
+// the simdjson backend of JsonDocument instead.
+class DailyLogDecoder : public nlohmann::json_sax<nlohmann::json> {
+public:
+  // Decodes the body into the given object. Returns false if the body isn't
+  // valid json, in which case the decoded object should be discarded.
+  static bool Decode(const std::string &content, DecodedDailyLog *decoded);
+
+  // Same as above, but with the simdjson backend the gamelogs entries are
+  // read in chunks by the pool. The streaming parser reads the body in order,
+  // so it doesn't use the pool.
+  static bool Decode(const std::string &content, ThreadPool *pool,
+                     DecodedDailyLog *decoded);
+
+  explicit DailyLogDecoder(DecodedDailyLog *decoded);
+  ~DailyLogDecoder() override = default;
+
+  bool null() override;
+  bool boolean(bool value) override;
+  bool number_integer(number_integer_t value) override;
+  bool number_unsigned(number_unsigned_t value) override;
+  bool number_float(number_float_t value, const string_t &text) override;
+  bool string(string_t &value) override;
+  bool binary(binary_t &value) override;
+  bool start_object(std::size_t elements) override;
+  bool key(string_t &value) override;
+  bool end_object() override;
+  bool start_array(std::size_t elements) override;
+  bool end_array() override;
+  bool parse_error(std::size_t position, const std::string &last_token,
+                   const nlohmann::detail::exception &error) override;
+
+private:
+  // Object or array of the response the parser is in.
+  enum class Context {
+    kRoot,
+    // The gamelogs array, and one of its entries.
+    kGameLogs,
+    kGameLog,
+    // The game, player and stats objects of a game log entry.
+    kGame,
+    kPlayer,
+    kStats,
+    // A stats category, e.g. fieldGoals.
+    kStatGroup,
+    kReferences,
+    // The playerReferences array, and one of its entries.
+    kPlayerReferences,
+    kPlayerReference,
+    // Anything else, along with everything it contains.
+    kSkipped,
+  };
+
+  // Game logs read by each task of the pool.
+  static const size_t kChunkSize;
+
+  // NOTE: This class doesn't have ownership of this object.
+  DecodedDailyLog *decoded_;
+
+  std::vector<Context> contexts_;
+
+  // Last key read in the current object.
+  std::string key_;
+
+  // Positions in feed_schema::kPlayerLogFields of the paths of the current
+  // kGame, kPlayer or kStatGroup object, resolved once when it starts, and
+  // of the path of the last key read in it, -1 if the key isn't decoded.
+  int fields_begin_ = 0;
+  int fields_end_ = 0;
+  int field_ = -1;
+
+  // True once the player id, and the stats object, of the current game log
+  // entry were read.
+  bool has_player_id_ = false;
+  bool has_stats_ = false;
+
+  Context current() const;
+
+  // Returns the context of an object or array starting in the current one.
+  Context child_context(bool is_array) const;
+
+  // Resolves the paths of the object starting in the given context, see
+  // fields_begin_.
+  void resolve_fields(Context context);
+
+  // Writes a number read in the current context, game log values to the
+  // member of the path resolved for their key.
+  void number(double value);
+};
+
+} // namespace fantasy_ball
+
+#endif // DAILY_LOG_DECODER_H_
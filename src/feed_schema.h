@@ -0,0 +1,146 @@
+#ifndef FEED_SCHEMA_H_
+#define FEED_SCHEMA_H_
+
+#include <cstddef>
+#include <cstring>
+
+#include "json_value.h"
+#include "player_fetcher.h"
+#include "symbol_table.h"
+#include "team_fetcher.h"
+
+namespace fantasy_ball {
+// Compile time description of the MySportsFeed responses that are decoded
+// into structs.
+namespace feed_schema {
+using PlayerLog = PlayerFetcher::PlayerLog;
+using GameMatchup = TeamFetcher::GameMatchup;
+
+// Path from an entry of a MySportsFeed response to a value, and the member of
+// the decoded struct it's written to, e.g. stats.fieldGoals.fgMade of a
+// gamelogs entry to PlayerLog::field_goals_made. Values are nested in one or
+// two objects of the entry. Only one of the members is set.
+template <typename T> struct FieldPath {
+  const char *object;
+  // Object nested in the first one, or nullptr.
+  const char *nested_object;
+  const char *name;
+  int T::*int_member;
+  float T::*float_member;
+  Symbol T::*symbol_member;
+};
+
+template <typename T>
+constexpr FieldPath<T> int_field(const char *object, const char *nested_object,
+                                 const char *name, int T::*member) {
+  return {object, nested_object, name, member, nullptr, nullptr};
+}
+
+template <typename T>
+constexpr FieldPath<T> float_field(const char *object,
+                                   const char *nested_object, const char *name,
+                                   float T::*member) {
+  return {object, nested_object, name, nullptr, member, nullptr};
+}
+
+template <typename T>
+constexpr FieldPath<T> symbol_field(const char *object,
+                                    const char *nested_object,
+                                    const char *name, Symbol T::*member) {
+  return {object, nested_object, name, nullptr, nullptr, member};
+}
+
+// Values of a gamelogs entry of the daily player log endpoint.
+// NOTE: Paths in the same object should stay next to each other, decoding
+// resolves each object once for its run of paths.
+constexpr FieldPath<PlayerLog> kPlayerLogFields[] = {
+    int_field("game", nullptr, "id", &PlayerLog::game_event_id),
+    int_field("player", nullptr, "id", &PlayerLog::player_id),
+    int_field("stats", "fieldGoals", "fgMade", &PlayerLog::field_goals_made),
+    int_field("stats", "fieldGoals", "fgAtt", &PlayerLog::field_goals_attempt),
+    float_field("stats", "fieldGoals", "fgPct",
+                &PlayerLog::field_goal_percentage),
+    int_field("stats", "fieldGoals", "fg3PtMade",
+              &PlayerLog::three_points_made),
+    int_field("stats", "fieldGoals", "fg3PtAtt",
+              &PlayerLog::three_points_attempt),
+    float_field("stats", "fieldGoals", "fg3PtPct",
+                &PlayerLog::three_points_percentage),
+    int_field("stats", "fieldGoals", "fg2PtMade", &PlayerLog::two_points_made),
+    int_field("stats", "fieldGoals", "fg2PtAtt",
+              &PlayerLog::two_points_attempt),
+    float_field("stats", "fieldGoals", "fg2PtPct",
+                &PlayerLog::two_points_percentage),
+    int_field("stats", "freeThrows", "ftMade", &PlayerLog::free_throws_made),
+    int_field("stats", "freeThrows", "ftAtt", &PlayerLog::free_throws_attempt),
+    float_field("stats", "freeThrows", "ftPct",
+                &PlayerLog::free_throws_percentage),
+    int_field("stats", "rebounds", "offReb", &PlayerLog::offensive_rebounds),
+    int_field("stats", "rebounds", "defReb", &PlayerLog::defensive_rebounds),
+    int_field("stats", "rebounds", "reb", &PlayerLog::total_rebounds),
+    int_field("stats", "offense", "ast", &PlayerLog::assists),
+    int_field("stats", "offense", "pts", &PlayerLog::points),
+    int_field("stats", "defense", "stl", &PlayerLog::steals),
+    int_field("stats", "defense", "blk", &PlayerLog::blocks),
+    int_field("stats", "defense", "tov", &PlayerLog::turnovers),
+    int_field("stats", "miscellaneous", "minSeconds",
+              &PlayerLog::seconds_played),
+    int_field("stats", "miscellaneous", "fouls", &PlayerLog::personal_fouls),
+};
+
+// Values of a games entry of the games endpoint.
+constexpr FieldPath<GameMatchup> kGameMatchupFields[] = {
+    int_field("schedule", nullptr, "id", &GameMatchup::event_id),
+    symbol_field("schedule", nullptr, "playedStatus",
+                 &GameMatchup::played_status),
+    symbol_field("schedule", "homeTeam", "abbreviation",
+                 &GameMatchup::home_team),
+    int_field("schedule", "homeTeam", "id", &GameMatchup::home_team_id),
+    symbol_field("schedule", "awayTeam", "abbreviation",
+                 &GameMatchup::away_team),
+    int_field("schedule", "awayTeam", "id", &GameMatchup::away_team_id),
+    int_field("score", nullptr, "homeScoreTotal", &GameMatchup::home_score),
+    int_field("score", nullptr, "awayScoreTotal", &GameMatchup::away_score),
+};
+
+// Returns true if both paths are in the same object of the entry.
+template <typename T>
+bool same_object(const FieldPath<T> &path, const FieldPath<T> &other) {
+  if (std::strcmp(path.object, other.object) != 0) {
+    return false;
+  }
+  if (path.nested_object == nullptr || other.nested_object == nullptr) {
+    return path.nested_object == other.nested_object;
+  }
+  return std::strcmp(path.nested_object, other.nested_object) == 0;
+}
+
+// Writes the value of every path into the decoded struct, in the order of the
+// paths. Missing values are read as zero or empty.
+template <typename T, size_t N>
+void decode_fields(const JsonValue &entry, const FieldPath<T> (&fields)[N],
+                   T *decoded) {
+  JsonValue object;
+  for (size_t i = 0; i < N; ++i) {
+    const auto &field = fields[i];
+    if (i == 0 || !same_object(field, fields[i - 1])) {
+      object = entry[field.object];
+      if (field.nested_object != nullptr) {
+        object = object[field.nested_object];
+      }
+    }
+    const auto value = object[field.name];
+    if (field.int_member != nullptr) {
+      decoded->*field.int_member = value.get_int();
+    } else if (field.float_member != nullptr) {
+      decoded->*field.float_member = value.get_float();
+    } else {
+      decoded->*field.symbol_member = value.get_string();
+    }
+  }
+}
+
+} // namespace feed_schema
+} // namespace fantasy_ball
+
+#endif // FEED_SCHEMA_H_
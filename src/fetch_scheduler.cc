@@ -0,0 +1,163 @@
+#include "fetch_scheduler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "util.h"
+
+namespace fantasy_ball {
+
+TokenBucket::TokenBucket(double tokens_per_second, double burst,
+                         std::chrono::milliseconds max_wait)
+    : tokens_per_second_(tokens_per_second > 0 ? tokens_per_second : 1),
+      burst_(burst >= 1 ? burst : 1), max_wait_(max_wait), tokens_(burst_),
+      last_refill_(Clock::now()) {}
+
+TokenBucket::Clock::time_point TokenBucket::Reserve(Clock::time_point now) {
+  refill(now);
+  if (tokens_ >= 1) {
+    tokens_ -= 1;
+    return now;
+  }
+  // Wait until the debt (including this reservation) is paid back.
+  const std::chrono::duration<double> wait((1 - tokens_) / tokens_per_second_);
+  if (wait > max_wait_) {
+    return Clock::time_point::max();
+  }
+  tokens_ -= 1;
+  return now + std::chrono::duration_cast<Clock::duration>(wait);
+}
+
+void TokenBucket::Cancel(Clock::time_point now) {
+  refill(now);
+  tokens_ = std::min(burst_, tokens_ + 1);
+}
+
+int64_t TokenBucket::Backlog(Clock::time_point now) {
+  refill(now);
+  if (tokens_ >= 0) {
+    return 0;
+  }
+  return static_cast<int64_t>(std::ceil(-tokens_));
+}
+
+void TokenBucket::refill(Clock::time_point now) {
+  if (now <= last_refill_) {
+    return;
+  }
+  const std::chrono::duration<double> elapsed = now - last_refill_;
+  tokens_ = std::min(burst_, tokens_ + elapsed.count() * tokens_per_second_);
+  last_refill_ = now;
+}
+
+FetchScheduler::FetchScheduler(const Limit &default_limit)
+    : default_limit_(default_limit) {}
+
+void FetchScheduler::SetLimit(const std::string &api_key, Family family,
+                              const Limit &limit) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  limits_[{api_key, family}] = limit;
+  buckets_.erase({api_key, family});
+}
+
+FetchScheduler::Bucket &
+FetchScheduler::bucket(const std::pair<std::string, Family> &key) {
+  auto it = buckets_.find(key);
+  if (it == buckets_.end()) {
+    auto limit_it = limits_.find(key);
+    const Limit &limit =
+        (limit_it == limits_.end() ? default_limit_ : limit_it->second);
+    it = buckets_.emplace(key, Bucket(limit)).first;
+  }
+  return it->second;
+}
+
+FetchScheduler::Clock::time_point
+FetchScheduler::Reserve(const std::string &api_key, const std::string &url) {
+  const auto now = Clock::now();
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto &bucket = this->bucket({api_key, family_for_url(url)});
+  const auto start = bucket.bucket.Reserve(now);
+  if (start == Clock::time_point::max()) {
+    ++bucket.stats.rejected;
+    return start;
+  }
+  const auto wait =
+      std::chrono::duration_cast<std::chrono::microseconds>(start - now);
+  ++bucket.stats.requests;
+  if (wait.count() > 0) {
+    ++bucket.stats.delayed;
+    bucket.stats.total_wait += wait;
+    bucket.stats.max_wait = std::max(bucket.stats.max_wait, wait);
+  }
+  return start;
+}
+
+void FetchScheduler::Refund(const std::string &api_key,
+                            const std::string &url) {
+  const auto now = Clock::now();
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto &bucket = this->bucket({api_key, family_for_url(url)});
+  bucket.bucket.Cancel(now);
+  ++bucket.stats.refunded;
+}
+
+bool FetchScheduler::Wait(const std::string &api_key, const std::string &url) {
+  const auto start = Reserve(api_key, url);
+  if (start == Clock::time_point::max()) {
+    return false;
+  }
+  std::this_thread::sleep_until(start);
+  return true;
+}
+
+std::map<std::string, FetchScheduler::Stats> FetchScheduler::GetStats() {
+  const auto now = Clock::now();
+  std::map<std::string, Stats> family_stats;
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto &entry : buckets_) {
+    auto &stats = family_stats[family_name(entry.first.second)];
+    auto &bucket = entry.second;
+    stats.requests += bucket.stats.requests;
+    stats.delayed += bucket.stats.delayed;
+    stats.queue_depth += bucket.bucket.Backlog(now);
+    stats.rejected += bucket.stats.rejected;
+    stats.refunded += bucket.stats.refunded;
+    stats.total_wait += bucket.stats.total_wait;
+    stats.max_wait = std::max(stats.max_wait, bucket.stats.max_wait);
+  }
+  return family_stats;
+}
+
+FetchScheduler::Family
+FetchScheduler::family_for_url(const std::string &url) {
+  const std::string name = endpoint::endpoint_name(url);
+  if (name == "player_gamelogs.json") {
+    return Family::kDailyLogs;
+  }
+  if (name == "games.json") {
+    return Family::kGames;
+  }
+  if (name == "players.json") {
+    return Family::kPlayers;
+  }
+  return Family::kOther;
+}
+
+std::string FetchScheduler::family_name(Family family) {
+  switch (family) {
+  case Family::kDailyLogs:
+    return "daily_logs";
+  case Family::kGames:
+    return "games";
+  case Family::kPlayers:
+    return "players";
+  default:
+    return "other";
+  }
+}
+} // namespace fantasy_ball
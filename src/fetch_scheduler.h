@@ -0,0 +1,144 @@
+#ifndef FETCH_SCHEDULER_H_
+#define FETCH_SCHEDULER_H_
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+
+namespace fantasy_ball {
+
+// Token bucket where callers reserve their token ahead of time. When the bucket
+// is empty, a reservation still succeeds but tells the caller how long it has
+// to wait. Since every reservation takes the bucket further into debt, callers
+// are served in the order they made their reservations. The debt is bounded by
+// the longest wait allowed.
+class TokenBucket {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  // The bucket starts full, allowing a burst of requests before the rate is
+  // enforced. Reservations that would have to wait longer than max_wait are
+  // rejected.
+  TokenBucket(double tokens_per_second, double burst,
+              std::chrono::milliseconds max_wait);
+  ~TokenBucket() = default;
+
+  // Takes a token and returns the time at which it can be used. Returns
+  // Clock::time_point::max() without taking a token if the wait would exceed
+  // the longest one allowed.
+  Clock::time_point Reserve(Clock::time_point now);
+
+  // Gives back a reserved token that wasn't used, e.g. for a request that was
+  // skipped.
+  void Cancel(Clock::time_point now);
+
+  // Returns the number of reservations that are still waiting on their token.
+  int64_t Backlog(Clock::time_point now);
+
+private:
+  double tokens_per_second_;
+  double burst_;
+  std::chrono::duration<double> max_wait_;
+
+  // Goes negative when tokens were reserved ahead of time.
+  double tokens_;
+  Clock::time_point last_refill_;
+
+  void refill(Clock::time_point now);
+};
+
+// Bounds the rate of the requests made to the MySportsFeed endpoints, with a
+// token bucket for each api key and endpoint family.
+// NOTE: Can be shared by several CurlFetch instances.
+class FetchScheduler {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  // Endpoints that share a quota.
+  enum class Family { kDailyLogs, kGames, kPlayers, kOther };
+
+  struct Limit {
+    Limit() = default;
+    Limit(double requests_per_second, double burst)
+        : requests_per_second(requests_per_second), burst(burst) {}
+    double requests_per_second = 1;
+    double burst = 1;
+
+    // Longest wait for a token, requests that would wait longer are rejected
+    // so that the backlog stays bounded.
+    std::chrono::milliseconds max_wait{60000};
+  };
+
+  struct Stats {
+    Stats() = default;
+    uint64_t requests = 0;
+
+    // Requests that had to wait for a token.
+    uint64_t delayed = 0;
+
+    // Requests currently waiting for a token.
+    int64_t queue_depth = 0;
+
+    // Requests rejected since they would have waited too long.
+    uint64_t rejected = 0;
+
+    // Reserved tokens given back by requests that were skipped.
+    uint64_t refunded = 0;
+
+    std::chrono::microseconds total_wait{0};
+    std::chrono::microseconds max_wait{0};
+  };
+
+  // The default limit is used for every api key and family without its own
+  // limit.
+  explicit FetchScheduler(const Limit &default_limit);
+  ~FetchScheduler() = default;
+
+  // Overrides the limit for the given api key and endpoint family.
+  // NOTE: Should be called before any request is made with that key.
+  void SetLimit(const std::string &api_key, Family family, const Limit &limit);
+
+  // Reserves a request to the url and returns the time at which it may start.
+  // Returns Clock::time_point::max() if the request is rejected, since it would
+  // wait longer than the max_wait of its limit.
+  Clock::time_point Reserve(const std::string &api_key, const std::string &url);
+
+  // Gives back the token reserved for a request to the url that was skipped.
+  void Refund(const std::string &api_key, const std::string &url);
+
+  // Blocks until a request to the url may start. Returns false right away if
+  // the request is rejected.
+  bool Wait(const std::string &api_key, const std::string &url);
+
+  // Returns the stats for each endpoint family, keyed by family name.
+  std::map<std::string, Stats> GetStats();
+
+  // Returns the family of the endpoint of the url.
+  static Family family_for_url(const std::string &url);
+
+  static std::string family_name(Family family);
+
+private:
+  struct Bucket {
+    explicit Bucket(const Limit &limit)
+        : bucket(limit.requests_per_second, limit.burst, limit.max_wait) {}
+    TokenBucket bucket;
+    Stats stats;
+  };
+
+  const Limit default_limit_;
+  std::mutex mutex_;
+  std::map<std::pair<std::string, Family>, Limit> limits_;
+  std::map<std::pair<std::string, Family>, Bucket> buckets_;
+
+  // Returns the bucket of the api key and family, created on first use.
+  // NOTE: The mutex should be held.
+  Bucket &bucket(const std::pair<std::string, Family> &key);
+};
+
+} // namespace fantasy_ball
+
+#endif // FETCH_SCHEDULER_H_
@@ -0,0 +1,74 @@
+#include "frequency_sketch.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+namespace fantasy_ball {
+const uint64_t FrequencySketch::kSeeds[kDepth] = {
+    0xc3a5c85c97cb3127ULL, 0xb492b66fbe98f273ULL, 0x9ae16a3b2f90404fULL,
+    0xcbf29ce484222325ULL};
+
+FrequencySketch::FrequencySketch() { EnsureCapacity(16); }
+
+void FrequencySketch::EnsureCapacity(size_t capacity) {
+  if (capacity <= capacity_) {
+    return;
+  }
+  // Grows to powers of two, so that a growing cache only forgets its counts a
+  // few times.
+  size_t size = 16;
+  while (size < capacity) {
+    size <<= 1;
+  }
+  capacity_ = size;
+  // NOTE: A word per key, i.e. 16 counters for the 4 counters of each key,
+  // keeps the estimates from colliding too often.
+  table_.assign(capacity_, 0);
+  sample_size_ = 10 * capacity_;
+  increments_ = 0;
+}
+
+void FrequencySketch::Increment(size_t hash) {
+  bool incremented = false;
+  for (int i = 0; i < kDepth; ++i) {
+    const size_t index = counter_index(hash, i);
+    const int shift = static_cast<int>(index & 15) << 2;
+    uint64_t &word = table_[index >> 4];
+    if (((word >> shift) & 15) < 15) {
+      word += (1ULL << shift);
+      incremented = true;
+    }
+  }
+  if (incremented && ++increments_ >= sample_size_) {
+    reset();
+  }
+}
+
+int FrequencySketch::Frequency(size_t hash) const {
+  int frequency = 15;
+  for (int i = 0; i < kDepth; ++i) {
+    const size_t index = counter_index(hash, i);
+    const int shift = static_cast<int>(index & 15) << 2;
+    frequency = std::min(
+        frequency, static_cast<int>((table_[index >> 4] >> shift) & 15));
+  }
+  return frequency;
+}
+
+size_t FrequencySketch::counter_index(size_t hash, int i) const {
+  // Spreads the bits of the hash, which may be as weak as an integer key.
+  uint64_t mixed = (static_cast<uint64_t>(hash) ^ kSeeds[i]) *
+                   0x9e3779b97f4a7c15ULL;
+  mixed ^= (mixed >> 29);
+  return static_cast<size_t>(mixed & ((table_.size() << 4) - 1));
+}
+
+void FrequencySketch::reset() {
+  for (auto &word : table_) {
+    word = (word >> 1) & 0x7777777777777777ULL;
+  }
+  increments_ /= 2;
+}
+
+} // namespace fantasy_ball
@@ -0,0 +1,53 @@
+#ifndef FREQUENCY_SKETCH_H_
+#define FREQUENCY_SKETCH_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace fantasy_ball {
+
+// Approximate access counts of recently used keys (a count-min sketch of 4 bit
+// counters), used by TinyLfuCache to tell frequently used entries from one-off
+// accesses. Once the number of increments reaches ten times the capacity, every
+// count is halved, so that old popularity fades.
+// NOTE: Not thread safe, callers should hold their own lock.
+class FrequencySketch {
+public:
+  FrequencySketch();
+  ~FrequencySketch() = default;
+
+  // Grows the sketch to count about the given number of keys. Growing forgets
+  // the counts.
+  void EnsureCapacity(size_t capacity);
+
+  // Counts an access to the key with the given hash.
+  void Increment(size_t hash);
+
+  // Returns the estimated number of recent accesses to the key with the given
+  // hash, at most 15.
+  int Frequency(size_t hash) const;
+
+private:
+  // Counters of each key, each one at a position picked with its own seed.
+  // The estimate is the lowest of them.
+  static const int kDepth = 4;
+  static const uint64_t kSeeds[kDepth];
+
+  // Packs 16 counters of 4 bits per word.
+  std::vector<uint64_t> table_;
+
+  size_t capacity_ = 0;
+  size_t sample_size_ = 0;
+  size_t increments_ = 0;
+
+  // Returns the position of the i-th counter of the key with the given hash.
+  size_t counter_index(size_t hash, int i) const;
+
+  // Halves every counter.
+  void reset();
+};
+
+} // namespace fantasy_ball
+
+#endif // FREQUENCY_SKETCH_H_
@@ -0,0 +1,171 @@
+#include "json_value.h"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace fantasy_ball {
+
+#ifdef FANTASY_BALL_USE_SIMDJSON
+
+JsonValue::JsonValue(simdjson::dom::element element)
+    : element_(element), valid_(true) {}
+
+bool JsonValue::is_null() const { return !valid_ || element_.is_null(); }
+
+bool JsonValue::is_array() const { return valid_ && element_.is_array(); }
+
+bool JsonValue::is_object() const { return valid_ && element_.is_object(); }
+
+bool JsonValue::contains(const char *key) const {
+  return !(*this)[key].is_null();
+}
+
+JsonValue JsonValue::operator[](const char *key) const {
+  simdjson::dom::object object;
+  simdjson::dom::element member;
+  if (!valid_ || element_.get_object().get(object) ||
+      object.at_key(key).get(member)) {
+    return JsonValue();
+  }
+  return JsonValue(member);
+}
+
+std::vector<JsonValue> JsonValue::items() const {
+  std::vector<JsonValue> items;
+  simdjson::dom::array array;
+  if (!valid_ || element_.get_array().get(array)) {
+    return items;
+  }
+  items.reserve(array.size());
+  for (simdjson::dom::element item : array) {
+    items.push_back(JsonValue(item));
+  }
+  return items;
+}
+
+int JsonValue::get_int() const {
+  if (!valid_) {
+    return 0;
+  }
+  int64_t integer = 0;
+  if (!element_.get_int64().get(integer)) {
+    return static_cast<int>(integer);
+  }
+  uint64_t unsigned_integer = 0;
+  if (!element_.get_uint64().get(unsigned_integer)) {
+    return static_cast<int>(unsigned_integer);
+  }
+  double number = 0;
+  if (!element_.get_double().get(number)) {
+    return static_cast<int>(number);
+  }
+  return 0;
+}
+
+float JsonValue::get_float() const {
+  double number = 0;
+  if (!valid_ || element_.get_double().get(number)) {
+    // Integers are read as doubles by get_double, anything else is zero.
+    return 0;
+  }
+  return static_cast<float>(number);
+}
+
+std::string JsonValue::get_string() const {
+  std::string_view text;
+  if (!valid_ || element_.get_string().get(text)) {
+    return std::string();
+  }
+  return std::string(text);
+}
+
+bool JsonDocument::Parse(const std::string &content) {
+  parsed_ = !parser_.parse(content).get(root_);
+  return parsed_;
+}
+
+JsonValue JsonDocument::root() const {
+  return (parsed_ ? JsonValue(root_) : JsonValue());
+}
+
+#else
+
+JsonValue::JsonValue(const nlohmann::json *value) : value_(value) {}
+
+bool JsonValue::is_null() const {
+  return value_ == nullptr || value_->is_null();
+}
+
+bool JsonValue::is_array() const {
+  return value_ != nullptr && value_->is_array();
+}
+
+bool JsonValue::is_object() const {
+  return value_ != nullptr && value_->is_object();
+}
+
+bool JsonValue::contains(const char *key) const {
+  return is_object() && value_->contains(key);
+}
+
+JsonValue JsonValue::operator[](const char *key) const {
+  if (!is_object()) {
+    return JsonValue();
+  }
+  const auto member = value_->find(key);
+  if (member == value_->end()) {
+    return JsonValue();
+  }
+  return JsonValue(&(*member));
+}
+
+std::vector<JsonValue> JsonValue::items() const {
+  std::vector<JsonValue> items;
+  if (!is_array()) {
+    return items;
+  }
+  items.reserve(value_->size());
+  for (const auto &item : *value_) {
+    items.push_back(JsonValue(&item));
+  }
+  return items;
+}
+
+int JsonValue::get_int() const {
+  if (value_ == nullptr || !value_->is_number()) {
+    return 0;
+  }
+  return value_->get<int>();
+}
+
+float JsonValue::get_float() const {
+  if (value_ == nullptr || !value_->is_number()) {
+    return 0;
+  }
+  return value_->get<float>();
+}
+
+std::string JsonValue::get_string() const {
+  if (value_ == nullptr || !value_->is_string()) {
+    return std::string();
+  }
+  return value_->get<std::string>();
+}
+
+bool JsonDocument::Parse(const std::string &content) {
+  // Invalid json content is discarded instead of throwing.
+  root_ = nlohmann::json::parse(content, nullptr, false);
+  if (root_.is_discarded()) {
+    root_ = nlohmann::json();
+    return false;
+  }
+  return true;
+}
+
+JsonValue JsonDocument::root() const { return JsonValue(&root_); }
+
+#endif
+
+} // namespace fantasy_ball
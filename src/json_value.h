@@ -0,0 +1,86 @@
+#ifndef JSON_VALUE_H_
+#define JSON_VALUE_H_
+
+#include <string>
+#include <vector>
+
+#ifdef FANTASY_BALL_USE_SIMDJSON
+#include <simdjson.h>
+#else
+#include <nlohmann/json.hpp>
+#endif
+
+namespace fantasy_ball {
+
+// Read-only view of a value of a parsed JsonDocument, used by the structs
+// that are read from the endpoint responses. The json backend is selected at
+// build time: nlohmann::json by default, or simdjson when built with
+// FANTASY_BALL_USE_SIMDJSON.
+// NOTE: Reading a missing key or a value of the wrong type doesn't throw, it
+// returns a null value or zero/empty instead. The value is only valid as long
+// as its document is.
+class JsonValue {
+public:
+  // A null value.
+  JsonValue() = default;
+
+  bool is_null() const;
+  bool is_array() const;
+  bool is_object() const;
+
+  bool contains(const char *key) const;
+
+  // Returns the member of an object, or a null value if there's none.
+  JsonValue operator[](const char *key) const;
+
+  // Returns the entries of an array, or none if this isn't an array.
+  std::vector<JsonValue> items() const;
+
+  // Numbers are converted to the requested type, e.g. 12.0 reads as 12.
+  int get_int() const;
+  float get_float() const;
+  std::string get_string() const;
+
+private:
+  friend class JsonDocument;
+
+#ifdef FANTASY_BALL_USE_SIMDJSON
+  explicit JsonValue(simdjson::dom::element element);
+
+  simdjson::dom::element element_;
+  bool valid_ = false;
+#else
+  explicit JsonValue(const nlohmann::json *value);
+
+  // NOTE: This class doesn't have ownership of this object.
+  const nlohmann::json *value_ = nullptr;
+#endif
+};
+
+// Parsed json content, which owns the values read from it.
+class JsonDocument {
+public:
+  JsonDocument() = default;
+  JsonDocument(const JsonDocument &) = delete;
+  JsonDocument &operator=(const JsonDocument &) = delete;
+
+  // Parses the content, replacing the previous one. Returns false if the
+  // content isn't valid json, in which case the root is a null value.
+  bool Parse(const std::string &content);
+
+  JsonValue root() const;
+
+private:
+#ifdef FANTASY_BALL_USE_SIMDJSON
+  // NOTE: The parser keeps the parsed values, it's reused by the next Parse.
+  simdjson::dom::parser parser_;
+  simdjson::dom::element root_;
+  bool parsed_ = false;
+#else
+  nlohmann::json root_;
+#endif
+};
+
+} // namespace fantasy_ball
+
+#endif // JSON_VALUE_H_
@@ -0,0 +1,107 @@
+#include "latency_histogram.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+namespace fantasy_ball {
+namespace {
+// Index of the most significant bit set, the value should be non zero.
+int most_significant_bit(uint64_t value) {
+  return 63 - __builtin_clzll(value);
+}
+} // namespace
+
+// 64 linear buckets per power of two, i.e. a relative precision of 1/64.
+const int LatencyHistogram::kSubBucketBits = 7;
+
+// About 12 days in microseconds.
+const uint64_t LatencyHistogram::kMaxValue = (1ULL << 40) - 1;
+
+LatencyHistogram::LatencyHistogram()
+    : counts_(bucket_index(kMaxValue) + 1, 0) {}
+
+void LatencyHistogram::Record(uint64_t value) {
+  value = std::min(value, kMaxValue);
+  ++counts_[bucket_index(value)];
+  if (count_ == 0 || value < min_) {
+    min_ = value;
+  }
+  max_ = std::max(max_, value);
+  ++count_;
+  sum_ += value;
+}
+
+void LatencyHistogram::Merge(const LatencyHistogram &other) {
+  if (other.count_ == 0) {
+    return;
+  }
+  for (size_t i = 0; i < counts_.size(); ++i) {
+    counts_[i] += other.counts_[i];
+  }
+  min_ = (count_ == 0 ? other.min_ : std::min(min_, other.min_));
+  max_ = std::max(max_, other.max_);
+  count_ += other.count_;
+  sum_ += other.sum_;
+}
+
+uint64_t LatencyHistogram::ValueAtPercentile(double percentile) const {
+  if (count_ == 0) {
+    return 0;
+  }
+  percentile = std::min(std::max(percentile, 0.0), 100.0);
+  const uint64_t rank = std::max<uint64_t>(
+      1, static_cast<uint64_t>(std::ceil(percentile / 100 * count_)));
+  uint64_t seen = 0;
+  for (size_t i = 0; i < counts_.size(); ++i) {
+    seen += counts_[i];
+    if (seen >= rank) {
+      // The bucket covers a range of values, which can't go past the
+      // recorded extremes.
+      return std::min(std::max(bucket_value(i), min_), max_);
+    }
+  }
+  return max_;
+}
+
+LatencyHistogram::Summary LatencyHistogram::GetSummary() const {
+  Summary summary;
+  summary.count = count_;
+  if (count_ == 0) {
+    return summary;
+  }
+  summary.min = min_;
+  summary.mean = sum_ / count_;
+  summary.p50 = ValueAtPercentile(50);
+  summary.p95 = ValueAtPercentile(95);
+  summary.p99 = ValueAtPercentile(99);
+  summary.max = max_;
+  return summary;
+}
+
+uint64_t LatencyHistogram::count() const { return count_; }
+
+size_t LatencyHistogram::bucket_index(uint64_t value) {
+  const uint64_t half_bucket_count = 1ULL << (kSubBucketBits - 1);
+  // Small values get a bucket each.
+  if (value < 2 * half_bucket_count) {
+    return value;
+  }
+  // Larger values are shifted down to the upper half of the linear buckets,
+  // the shift telling which power of two range they belong to.
+  const int shift = most_significant_bit(value) - (kSubBucketBits - 1);
+  const uint64_t sub_bucket = value >> shift;
+  return (shift + 1) * half_bucket_count + (sub_bucket - half_bucket_count);
+}
+
+uint64_t LatencyHistogram::bucket_value(size_t index) {
+  const uint64_t half_bucket_count = 1ULL << (kSubBucketBits - 1);
+  if (index < 2 * half_bucket_count) {
+    return index;
+  }
+  const int shift = index / half_bucket_count - 1;
+  const uint64_t sub_bucket = index % half_bucket_count + half_bucket_count;
+  return ((sub_bucket + 1) << shift) - 1;
+}
+} // namespace fantasy_ball
@@ -0,0 +1,65 @@
+#ifndef LATENCY_HISTOGRAM_H_
+#define LATENCY_HISTOGRAM_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace fantasy_ball {
+
+// HDR style histogram: values are counted in log-linear buckets, so that every
+// recorded value is kept with a relative precision of about 1.5%, whatever its
+// magnitude, in a fixed amount of memory. Used for latencies in
+// microseconds, but any positive value (e.g. bytes) can be recorded.
+// NOTE: Not thread safe, callers should hold their own lock.
+class LatencyHistogram {
+public:
+  struct Summary {
+    Summary() = default;
+    uint64_t count = 0;
+    uint64_t min = 0;
+    uint64_t mean = 0;
+    uint64_t p50 = 0;
+    uint64_t p95 = 0;
+    uint64_t p99 = 0;
+    uint64_t max = 0;
+  };
+
+  LatencyHistogram();
+  ~LatencyHistogram() = default;
+
+  // Values above kMaxValue are counted as kMaxValue.
+  void Record(uint64_t value);
+
+  // Adds the values recorded by the other histogram.
+  void Merge(const LatencyHistogram &other);
+
+  // Returns the value under which the given percentage (0 to 100) of the
+  // recorded values fall, within the precision of the buckets.
+  uint64_t ValueAtPercentile(double percentile) const;
+
+  Summary GetSummary() const;
+
+  uint64_t count() const;
+
+  static const uint64_t kMaxValue;
+
+private:
+  // Every power of two range is split in this many linear buckets.
+  static const int kSubBucketBits;
+
+  std::vector<uint64_t> counts_;
+  uint64_t count_ = 0;
+  uint64_t sum_ = 0;
+  uint64_t min_ = 0;
+  uint64_t max_ = 0;
+
+  static size_t bucket_index(uint64_t value);
+
+  // Returns the highest value counted in the bucket.
+  static uint64_t bucket_value(size_t index);
+};
+
+} // namespace fantasy_ball
+
+#endif // LATENCY_HISTOGRAM_H_
@@ -0,0 +1,375 @@
+#include "msf_stub_data.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <ctime>
+#include <fstream>
+#include <mutex>
+#include <nlohmann/json.hpp>
+#include <random>
+#include <sstream>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "util.h"
+
+namespace fantasy_ball {
+namespace {
+using json = nlohmann::json;
+
+struct Team {
+  int id;
+  const char *abbreviation;
+};
+
+const std::vector<Team> kTeams = {
+    {81, "BOS"},  {82, "BRO"}, {83, "NYK"}, {84, "PHI"}, {85, "TOR"},
+    {86, "CHI"},  {87, "CLE"}, {88, "DET"}, {89, "IND"}, {90, "MIL"},
+    {91, "ATL"},  {92, "CHA"}, {93, "MIA"}, {94, "ORL"}, {95, "WAS"},
+    {96, "DEN"},  {97, "MIN"}, {98, "OKL"}, {99, "POR"}, {100, "UTA"},
+    {101, "GSW"}, {102, "LAC"}, {103, "LAL"}, {104, "PHX"}, {105, "SAC"},
+    {106, "DAL"}, {107, "HOU"}, {108, "MEM"}, {109, "NOP"}, {110, "SAS"},
+};
+
+const std::vector<std::string> kPositions = {"PG", "SG", "SF", "PF", "C"};
+
+// Players given to each team of the date when no players are requested.
+const int kDefaultPlayersPerTeam = 8;
+
+json make_team(const Team &team) {
+  return {{"id", team.id}, {"abbreviation", team.abbreviation}};
+}
+
+// Percentage with one decimal, like the endpoint returns them.
+double percentage(int made, int attempts) {
+  if (attempts == 0) {
+    return 0.0;
+  }
+  return std::round(made * 1000.0 / attempts) / 10.0;
+}
+
+std::string capitalize(std::string word) {
+  if (!word.empty()) {
+    word[0] = std::toupper(static_cast<unsigned char>(word[0]));
+  }
+  return word;
+}
+
+// Returns today's date in the endpoint format, e.g. 20210319.
+std::string today() {
+  const std::time_t now = std::time(nullptr);
+  std::tm local_time = {};
+  localtime_r(&now, &local_time);
+  char date[9];
+  std::strftime(date, sizeof(date), "%Y%m%d", &local_time);
+  return date;
+}
+} // namespace
+
+const size_t MsfStubData::kMaxCachedBodies = 4096;
+
+MsfStubData::MsfStubData(const std::string &fixtures_directory)
+    : fixtures_directory_(fixtures_directory) {}
+
+std::string MsfStubData::GetBody(const std::string &target) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = bodies_.find(target);
+    if (it != bodies_.end()) {
+      return it->second;
+    }
+  }
+  Request request;
+  if (!parse_target(target, &request)) {
+    return "";
+  }
+  std::string body = make_body(request);
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (bodies_.size() >= kMaxCachedBodies) {
+    bodies_.clear();
+  }
+  bodies_.emplace(target, body);
+  return body;
+}
+
+std::string MsfStubData::make_body(const Request &request) {
+  if (request.endpoint == "games.json") {
+    const std::string fixture = read_fixture(request.date + "/games.json");
+    return fixture.empty() ? make_games(request.date).dump() : fixture;
+  }
+  if (request.endpoint == "player_gamelogs.json") {
+    const std::string fixture =
+        read_fixture(request.date + "/player_gamelogs.json");
+    json daily_logs = json::parse(fixture, nullptr, false);
+    if (fixture.empty() || daily_logs.is_discarded()) {
+      return make_game_logs(request.date, request.players).dump();
+    }
+    return filter_game_logs(daily_logs, request.players).dump();
+  }
+
+  // players.json
+  const std::string fixture = read_fixture("players.json");
+  json players = json::parse(fixture, nullptr, false);
+  if (fixture.empty() || players.is_discarded()) {
+    return make_players(request.players).dump();
+  }
+  if (request.players.empty() || !players.contains("players")) {
+    return fixture;
+  }
+  std::unordered_set<std::string> entries(request.players.begin(),
+                                          request.players.end());
+  json matching = json::array();
+  for (const auto &reference : players["players"]) {
+    if (!reference.contains("player")) {
+      continue;
+    }
+    const auto &player = reference["player"];
+    const std::string name =
+        string_to_lower(player.value("firstName", "") + "-" +
+                        player.value("lastName", ""));
+    if (entries.count(std::to_string(player.value("id", -1))) ||
+        entries.count(name)) {
+      matching.push_back(reference);
+    }
+  }
+  players["players"] = matching;
+  return players.dump();
+}
+
+std::string MsfStubData::read_fixture(const std::string &relative_path) {
+  if (fixtures_directory_.empty()) {
+    return "";
+  }
+  std::ifstream file(fixtures_directory_ + "/" + relative_path);
+  if (!file.is_open()) {
+    return "";
+  }
+  std::stringstream content;
+  content << file.rdbuf();
+  return content.str();
+}
+
+json MsfStubData::filter_game_logs(const json &daily_logs,
+                                   const std::vector<std::string> &players) {
+  if (players.empty() || !daily_logs.contains("gamelogs")) {
+    return daily_logs;
+  }
+  // Names are resolved to ids through the player references.
+  std::unordered_set<int> ids;
+  std::unordered_set<std::string> names;
+  for (const auto &entry : players) {
+    if (is_number(entry)) {
+      ids.insert(std::stoi(entry));
+    } else {
+      names.insert(string_to_lower(entry));
+    }
+  }
+  json filtered = daily_logs;
+  json references = json::array();
+  if (daily_logs.contains("references") &&
+      daily_logs["references"].contains("playerReferences")) {
+    for (const auto &reference : daily_logs["references"]["playerReferences"]) {
+      const int id = reference.value("id", -1);
+      const std::string name =
+          string_to_lower(reference.value("firstName", "") + "-" +
+                          reference.value("lastName", ""));
+      if (names.count(name)) {
+        ids.insert(id);
+      }
+      if (ids.count(id)) {
+        references.push_back(reference);
+      }
+    }
+    filtered["references"]["playerReferences"] = references;
+  }
+  json game_logs = json::array();
+  for (const auto &game_log : daily_logs["gamelogs"]) {
+    if (game_log.contains("player") &&
+        ids.count(game_log["player"].value("id", -1))) {
+      game_logs.push_back(game_log);
+    }
+  }
+  filtered["gamelogs"] = game_logs;
+  return filtered;
+}
+
+bool MsfStubData::parse_target(const std::string &target, Request *request) {
+  const auto query_pos = target.find('?');
+  const auto segments = split(target.substr(0, query_pos), "/");
+  request->endpoint = segments.back();
+  if (request->endpoint != "games.json" &&
+      request->endpoint != "player_gamelogs.json" &&
+      request->endpoint != "players.json") {
+    return false;
+  }
+  auto date_it = std::find(segments.begin(), segments.end(), "date");
+  if (date_it != segments.end() && date_it + 1 != segments.end()) {
+    request->date = *(date_it + 1);
+  }
+  if (request->date.empty() && request->endpoint != "players.json") {
+    return false;
+  }
+  if (query_pos == std::string::npos) {
+    return true;
+  }
+  for (const auto &parameter : split(target.substr(query_pos + 1), "&")) {
+    if (parameter.compare(0, 7, "player=") != 0) {
+      continue;
+    }
+    for (const auto &entry : split(parameter.substr(7), ",")) {
+      if (!entry.empty()) {
+        request->players.push_back(entry);
+      }
+    }
+  }
+  return true;
+}
+
+json MsfStubData::make_games(const std::string &date) {
+  const uint64_t seed = fnv1a_hash(date);
+  std::mt19937 generator(seed);
+  std::vector<Team> teams = kTeams;
+  std::shuffle(teams.begin(), teams.end(), generator);
+  const int game_count = 5 + seed % 6;
+  // e.g. 21031900 for the first game of 20210319.
+  const int first_id =
+      (is_number(date) && date.size() == 8 ? std::stoi(date.substr(2))
+                                           : static_cast<int>(seed % 1000000)) *
+      100;
+  const std::string played_status =
+      (date < today() ? "COMPLETED" : date == today() ? "LIVE" : "UNPLAYED");
+
+  std::uniform_int_distribution<int> score(85, 135);
+  json games = json::array();
+  for (int i = 0; i < game_count; ++i) {
+    json game;
+    game["schedule"] = {{"id", first_id + i},
+                        {"awayTeam", make_team(teams[2 * i])},
+                        {"homeTeam", make_team(teams[2 * i + 1])},
+                        {"playedStatus", played_status}};
+    game["score"] = {{"awayScoreTotal", score(generator)},
+                     {"homeScoreTotal", score(generator)}};
+    games.push_back(game);
+  }
+  return {{"games", games}};
+}
+
+json MsfStubData::make_game_logs(const std::string &date,
+                                 const std::vector<std::string> &players) {
+  const json games = make_games(date)["games"];
+  const auto entries = (players.empty() ? default_players(games) : players);
+  json game_logs = json::array();
+  json player_references = json::array();
+  for (const auto &entry : entries) {
+    const auto player = make_player(entry);
+    // Every player plays in one of the games of the date.
+    const auto &game = games[player.id % games.size()];
+    const auto &team =
+        game["schedule"][(player.id / games.size()) % 2 ? "homeTeam"
+                                                         : "awayTeam"];
+    std::mt19937 generator(fnv1a_hash(date) ^ player.id);
+    auto random = [&generator](int min, int max) {
+      return std::uniform_int_distribution<int>(min, max)(generator);
+    };
+    const int two_points_attempt = random(0, 18);
+    const int two_points_made = random(0, two_points_attempt);
+    const int three_points_attempt = random(0, 10);
+    const int three_points_made = random(0, three_points_attempt);
+    const int free_throws_attempt = random(0, 10);
+    const int free_throws_made = random(0, free_throws_attempt);
+    const int field_goals_attempt = two_points_attempt + three_points_attempt;
+    const int field_goals_made = two_points_made + three_points_made;
+    const int offensive_rebounds = random(0, 5);
+    const int defensive_rebounds = random(0, 10);
+
+    json stats;
+    stats["fieldGoals"] = {
+        {"fgMade", field_goals_made},
+        {"fgAtt", field_goals_attempt},
+        {"fgPct", percentage(field_goals_made, field_goals_attempt)},
+        {"fg2PtMade", two_points_made},
+        {"fg2PtAtt", two_points_attempt},
+        {"fg2PtPct", percentage(two_points_made, two_points_attempt)},
+        {"fg3PtMade", three_points_made},
+        {"fg3PtAtt", three_points_attempt},
+        {"fg3PtPct", percentage(three_points_made, three_points_attempt)}};
+    stats["freeThrows"] = {
+        {"ftMade", free_throws_made},
+        {"ftAtt", free_throws_attempt},
+        {"ftPct", percentage(free_throws_made, free_throws_attempt)}};
+    stats["rebounds"] = {{"offReb", offensive_rebounds},
+                         {"defReb", defensive_rebounds},
+                         {"reb", offensive_rebounds + defensive_rebounds}};
+    stats["offense"] = {{"ast", random(0, 12)},
+                        {"pts", 2 * two_points_made + 3 * three_points_made +
+                                    free_throws_made}};
+    stats["defense"] = {
+        {"stl", random(0, 4)}, {"blk", random(0, 4)}, {"tov", random(0, 6)}};
+    stats["miscellaneous"] = {{"minSeconds", random(600, 2400)},
+                              {"fouls", random(0, 6)}};
+
+    json game_log;
+    game_log["game"] = {{"id", game["schedule"]["id"]}};
+    game_log["player"] = {{"id", player.id},
+                          {"firstName", player.first_name},
+                          {"lastName", player.last_name},
+                          {"position", player.position}};
+    game_log["team"] = team;
+    game_log["stats"] = stats;
+    game_logs.push_back(game_log);
+
+    player_references.push_back({{"id", player.id},
+                                 {"firstName", player.first_name},
+                                 {"lastName", player.last_name},
+                                 {"primaryPosition", player.position},
+                                 {"officialImageSrc", nullptr}});
+  }
+  return {{"gamelogs", game_logs},
+          {"references", {{"playerReferences", player_references}}}};
+}
+
+json MsfStubData::make_players(const std::vector<std::string> &players) {
+  json references = json::array();
+  for (const auto &entry : players) {
+    const auto player = make_player(entry);
+    json reference;
+    reference["player"] = {{"id", player.id},
+                           {"firstName", player.first_name},
+                           {"lastName", player.last_name},
+                           {"primaryPosition", player.position}};
+    reference["teamAsOfDate"] = make_team(kTeams[player.id % kTeams.size()]);
+    references.push_back(reference);
+  }
+  return {{"players", references}};
+}
+
+MsfStubData::SyntheticPlayer
+MsfStubData::make_player(const std::string &entry) {
+  SyntheticPlayer player;
+  if (is_number(entry)) {
+    player.id = std::stoi(entry);
+    player.first_name = "Player";
+    player.last_name = entry;
+  } else {
+    const auto names = split(string_to_lower(entry), "-");
+    player.id = 100000 + fnv1a_hash(string_to_lower(entry)) % 900000;
+    player.first_name = capitalize(names.front());
+    for (size_t i = 1; i < names.size(); ++i) {
+      player.last_name += (i > 1 ? " " : "") + capitalize(names[i]);
+    }
+  }
+  player.position = kPositions[player.id % kPositions.size()];
+  return player;
+}
+
+std::vector<std::string> MsfStubData::default_players(const json &games) {
+  std::vector<std::string> players;
+  const size_t player_count = games.size() * 2 * kDefaultPlayersPerTeam;
+  for (size_t i = 0; i < player_count; ++i) {
+    players.push_back(std::to_string(1000 + i));
+  }
+  return players;
+}
+} // namespace fantasy_ball
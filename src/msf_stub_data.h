@@ -0,0 +1,87 @@
+#ifndef MSF_STUB_DATA_H_
+#define MSF_STUB_DATA_H_
+
+#include <cstdint>
+#include <mutex>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace fantasy_ball {
+
+// Builds the responses of the MySportsFeed endpoints served by the
+// msf_stub_server (games.json, player_gamelogs.json and players.json), so that
+// the fetch path can be exercised without an api key or quota.
+class MsfStubData {
+public:
+  // Fixture files are looked up as:
+  //   <fixtures_directory>/<date>/games.json
+  //   <fixtures_directory>/<date>/player_gamelogs.json
+  //   <fixtures_directory>/players.json
+  // Missing fixtures (or an empty directory) fall back to synthetic data, which
+  // is the same every time for a given date and player list.
+  explicit MsfStubData(const std::string &fixtures_directory);
+  ~MsfStubData() = default;
+
+  // Returns the json body for the request target (path and query), or an
+  // empty string if the target isn't one of the endpoints.
+  std::string GetBody(const std::string &target);
+
+private:
+  // Endpoint request read from a target like
+  // /v2.1/pull/nba/2020-2021-regular/date/20210319/games.json
+  struct Request {
+    Request() = default;
+    std::string endpoint;
+    std::string date;
+
+    // Entries of the player parameter, either ids or first-last names.
+    std::vector<std::string> players;
+  };
+
+  // Player made up from a player list entry.
+  struct SyntheticPlayer {
+    SyntheticPlayer() = default;
+    int id = 0;
+    std::string first_name;
+    std::string last_name;
+    std::string position;
+  };
+
+  // Synthetic bodies are kept up to this many targets.
+  static const size_t kMaxCachedBodies;
+
+  std::string fixtures_directory_;
+  std::mutex mutex_;
+  std::unordered_map<std::string, std::string> bodies_;
+
+  std::string make_body(const Request &request);
+
+  // Returns the content of the fixture file, or an empty string if there's
+  // none.
+  std::string read_fixture(const std::string &relative_path);
+
+  // Keeps the game logs (and their player references) of the requested
+  // players. Every log is kept when no players were requested.
+  static nlohmann::json
+  filter_game_logs(const nlohmann::json &daily_logs,
+                   const std::vector<std::string> &players);
+
+  static bool parse_target(const std::string &target, Request *request);
+
+  static nlohmann::json make_games(const std::string &date);
+  static nlohmann::json make_game_logs(const std::string &date,
+                                       const std::vector<std::string> &players);
+  static nlohmann::json make_players(const std::vector<std::string> &players);
+
+  static SyntheticPlayer make_player(const std::string &entry);
+
+  // Default roster when no players are requested, every team of the date
+  // gets a few players.
+  static std::vector<std::string> default_players(const nlohmann::json &games);
+};
+
+} // namespace fantasy_ball
+
+#endif // MSF_STUB_DATA_H_
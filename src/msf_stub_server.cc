@@ -0,0 +1,351 @@
+#include <arpa/inet.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <random>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include <zlib.h>
+
+#include "msf_stub_data.h"
+#include "util.h"
+
+// Local stand-in for the MySportsFeed endpoints, used to load test the fetch
+// path (e.g. player_team_server with MSF_BASE_URL=http://localhost:8089)
+// without an api key or quota. Serves HTTP/1.1 with keep-alive, gzip and ETag
+// revalidation, and can inject latency, errors and throttling.
+
+// Configuration read from the command line flags:
+//   --port=<listening port>
+//   --fixtures_dir=<directory of the fixture files, synthetic data otherwise>
+//   --latency_ms=<delay added to every response>
+//   --latency_jitter_ms=<random delay added on top of the latency>
+//   --error_rate=<fraction of the requests answered with 503>
+//   --requests_per_second=<requests answered per second before 429s, 0 for
+//                          no limit>
+//   --gzip=<true|false>
+struct StubConfig {
+  StubConfig() = default;
+  int port = 8089;
+  std::string fixtures_directory;
+  int latency_ms = 0;
+  int latency_jitter_ms = 0;
+  double error_rate = 0;
+  int requests_per_second = 0;
+  bool gzip = true;
+};
+
+struct HttpRequest {
+  HttpRequest() = default;
+  std::string method;
+  std::string target;
+  bool accepts_gzip = false;
+  bool keep_alive = true;
+  std::string if_none_match;
+  size_t content_length = 0;
+};
+
+struct HttpResponse {
+  HttpResponse() = default;
+  int status = 200;
+  std::string body;
+  std::string etag;
+  bool gzipped = false;
+  bool throttled = false;
+};
+
+StubConfig config_from_flags(int argc, char *argv[]) {
+  StubConfig config = {};
+  for (int i = 1; i < argc; ++i) {
+    const auto flag = fantasy_ball::split(argv[i], "=");
+    if (flag.size() != 2) {
+      continue;
+    }
+    if (flag[0] == "--port") {
+      config.port = std::stoi(flag[1]);
+    } else if (flag[0] == "--fixtures_dir") {
+      config.fixtures_directory = flag[1];
+    } else if (flag[0] == "--latency_ms") {
+      config.latency_ms = std::stoi(flag[1]);
+    } else if (flag[0] == "--latency_jitter_ms") {
+      config.latency_jitter_ms = std::stoi(flag[1]);
+    } else if (flag[0] == "--error_rate") {
+      config.error_rate = std::stod(flag[1]);
+    } else if (flag[0] == "--requests_per_second") {
+      config.requests_per_second = std::stoi(flag[1]);
+    } else if (flag[0] == "--gzip") {
+      config.gzip = (flag[1] == "true");
+    }
+  }
+  return config;
+}
+
+class StubServer {
+public:
+  explicit StubServer(const StubConfig &config)
+      : config_(config), data_(config.fixtures_directory) {}
+
+  HttpResponse Handle(const HttpRequest &request) {
+    HttpResponse response;
+    if (request.method != "GET") {
+      response.status = 405;
+      return response;
+    }
+    if (throttled()) {
+      response.status = 429;
+      response.throttled = true;
+      return response;
+    }
+    const int delay_ms =
+        config_.latency_ms + random_int(config_.latency_jitter_ms);
+    if (delay_ms > 0) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(delay_ms));
+    }
+    if (config_.error_rate > 0 && random_double() < config_.error_rate) {
+      response.status = 503;
+      return response;
+    }
+    response.body = data_.GetBody(request.target);
+    if (response.body.empty()) {
+      response.status = 404;
+      return response;
+    }
+    response.etag = etag(response.body);
+    if (request.if_none_match == response.etag) {
+      response.status = 304;
+      response.body.clear();
+      return response;
+    }
+    if (config_.gzip && request.accepts_gzip) {
+      response.gzipped = gzip(&response.body);
+    }
+    return response;
+  }
+
+private:
+  StubConfig config_;
+  fantasy_ball::MsfStubData data_;
+
+  // Requests answered in the current one second window.
+  std::mutex window_mutex_;
+  std::chrono::steady_clock::time_point window_start_;
+  int window_requests_ = 0;
+
+  // Fixed window limit, like the endpoint quotas.
+  bool throttled() {
+    if (config_.requests_per_second <= 0) {
+      return false;
+    }
+    const auto now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(window_mutex_);
+    if (now - window_start_ >= std::chrono::seconds(1)) {
+      window_start_ = now;
+      window_requests_ = 0;
+    }
+    return ++window_requests_ > config_.requests_per_second;
+  }
+
+  static int random_int(int max) {
+    if (max <= 0) {
+      return 0;
+    }
+    thread_local std::mt19937 generator(std::random_device{}());
+    return std::uniform_int_distribution<int>(0, max)(generator);
+  }
+
+  static double random_double() {
+    thread_local std::mt19937 generator(std::random_device{}());
+    return std::uniform_real_distribution<double>(0, 1)(generator);
+  }
+
+  static std::string etag(const std::string &body) {
+    const uint64_t hash = fantasy_ball::fnv1a_hash(body);
+    char value[20];
+    std::snprintf(value, sizeof(value), "\"%016llx\"",
+                  static_cast<unsigned long long>(hash));
+    return value;
+  }
+
+  static bool gzip(std::string *body) {
+    z_stream stream = {};
+    // 16 + 15 window bits asks zlib for a gzip wrapper.
+    if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 16 + 15, 8,
+                     Z_DEFAULT_STRATEGY) != Z_OK) {
+      return false;
+    }
+    std::string compressed(deflateBound(&stream, body->size()), '\0');
+    stream.next_in = reinterpret_cast<Bytef *>(&(*body)[0]);
+    stream.avail_in = body->size();
+    stream.next_out = reinterpret_cast<Bytef *>(&compressed[0]);
+    stream.avail_out = compressed.size();
+    const bool done = deflate(&stream, Z_FINISH) == Z_STREAM_END;
+    compressed.resize(stream.total_out);
+    deflateEnd(&stream);
+    if (done) {
+      body->swap(compressed);
+    }
+    return done;
+  }
+};
+
+const char *status_text(int status) {
+  switch (status) {
+  case 200:
+    return "OK";
+  case 304:
+    return "Not Modified";
+  case 404:
+    return "Not Found";
+  case 405:
+    return "Method Not Allowed";
+  case 429:
+    return "Too Many Requests";
+  default:
+    return "Service Unavailable";
+  }
+}
+
+// Reads the request line and the headers. Returns false if the header block
+// is malformed.
+bool parse_request(const std::string &header_block, HttpRequest *request) {
+  const auto lines = fantasy_ball::split(header_block, "\r\n");
+  const auto request_line = fantasy_ball::split(lines.front(), " ");
+  if (request_line.size() != 3) {
+    return false;
+  }
+  request->method = request_line[0];
+  request->target = request_line[1];
+  request->keep_alive = (request_line[2] == "HTTP/1.1");
+  for (size_t i = 1; i < lines.size(); ++i) {
+    const auto colon_pos = lines[i].find(':');
+    if (colon_pos == std::string::npos) {
+      continue;
+    }
+    const std::string name =
+        fantasy_ball::string_to_lower(lines[i].substr(0, colon_pos));
+    std::string value = lines[i].substr(colon_pos + 1);
+    value.erase(0, value.find_first_not_of(" \t"));
+    if (name == "accept-encoding") {
+      request->accepts_gzip = value.find("gzip") != std::string::npos;
+    } else if (name == "if-none-match") {
+      request->if_none_match = value;
+    } else if (name == "connection") {
+      request->keep_alive =
+          fantasy_ball::string_to_lower(value).find("close") ==
+          std::string::npos;
+    } else if (name == "content-length") {
+      request->content_length = std::strtoul(value.c_str(), nullptr, 10);
+    }
+  }
+  return true;
+}
+
+bool send_all(int socket_fd, const std::string &data) {
+  size_t sent = 0;
+  while (sent < data.size()) {
+    const ssize_t count = send(socket_fd, data.data() + sent,
+                               data.size() - sent, MSG_NOSIGNAL);
+    if (count <= 0) {
+      return false;
+    }
+    sent += count;
+  }
+  return true;
+}
+
+// Serves the requests of a single (keep-alive) connection.
+void serve_connection(int socket_fd, StubServer *server) {
+  std::string buffer;
+  char chunk[16 * 1024];
+  while (true) {
+    size_t header_end;
+    while ((header_end = buffer.find("\r\n\r\n")) == std::string::npos) {
+      const ssize_t count = recv(socket_fd, chunk, sizeof(chunk), 0);
+      if (count <= 0) {
+        close(socket_fd);
+        return;
+      }
+      buffer.append(chunk, count);
+    }
+    HttpRequest request;
+    if (!parse_request(buffer.substr(0, header_end), &request)) {
+      break;
+    }
+    // Request bodies aren't used by the endpoints, skip them.
+    const size_t request_size = header_end + 4 + request.content_length;
+    while (buffer.size() < request_size) {
+      const ssize_t count = recv(socket_fd, chunk, sizeof(chunk), 0);
+      if (count <= 0) {
+        close(socket_fd);
+        return;
+      }
+      buffer.append(chunk, count);
+    }
+    buffer.erase(0, request_size);
+
+    const auto response = server->Handle(request);
+    std::string message = "HTTP/1.1 " + std::to_string(response.status) + " " +
+                          status_text(response.status) + "\r\n";
+    message += "Content-Type: application/json\r\n";
+    message += "Content-Length: " + std::to_string(response.body.size()) +
+               "\r\n";
+    if (!response.etag.empty()) {
+      message += "ETag: " + response.etag + "\r\n";
+    }
+    if (response.gzipped) {
+      message += "Content-Encoding: gzip\r\n";
+    }
+    if (response.throttled) {
+      message += "Retry-After: 1\r\n";
+    }
+    if (!request.keep_alive) {
+      message += "Connection: close\r\n";
+    }
+    message += "\r\n";
+    message += response.body;
+    if (!send_all(socket_fd, message) || !request.keep_alive) {
+      break;
+    }
+  }
+  close(socket_fd);
+}
+
+int main(int argc, char *argv[]) {
+  const StubConfig config = config_from_flags(argc, argv);
+  const int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+  const int enable = 1;
+  setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+  sockaddr_in address = {};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_ANY);
+  address.sin_port = htons(config.port);
+  if (bind(listen_fd, reinterpret_cast<sockaddr *>(&address),
+           sizeof(address)) != 0 ||
+      listen(listen_fd, SOMAXCONN) != 0) {
+    std::cout << "Couldn't listen on port " << config.port << "." << std::endl;
+    return 1;
+  }
+
+  StubServer server(config);
+  std::cout << "MySportsFeed stub listening on 0.0.0.0:" << config.port
+            << (config.fixtures_directory.empty()
+                    ? " with synthetic data."
+                    : " with fixtures from " + config.fixtures_directory + ".")
+            << std::endl;
+  while (true) {
+    const int socket_fd = accept(listen_fd, nullptr, nullptr);
+    if (socket_fd < 0) {
+      continue;
+    }
+    setsockopt(socket_fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+    std::thread(serve_connection, socket_fd, &server).detach();
+  }
+  return 0;
+}
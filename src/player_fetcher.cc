@@ -1,10 +1,18 @@
 #include "player_fetcher.h"
 
 #include <algorithm>
-#include <nlohmann/json.hpp>
+#include <chrono>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include "curl_fetch.h"
+#include "daily_log_decoder.h"
+#include "feed_schema.h"
+#include "json_value.h"
 #include "util.h"
 
 namespace fantasy_ball {
@@ -13,15 +21,17 @@ const std::string PlayerFetcher::kDefaultSeasonStart = "2020-2021-regular";
 const std::string PlayerFetcher::kDefaultDate = "20210320";
 const bool PlayerFetcher::kDefaultStrictSearch = true;
 const std::string PlayerFetcher::kDailyPlayerLogUrl =
-    "https://api.mysportsfeeds.com/<version>/pull/nba/<season-start>/date/"
-    "<date>/player_gamelogs.json?";
+    "<base>/<version>/pull/nba/<season-start>/date/<date>/"
+    "player_gamelogs.json?";
 const std::string PlayerFetcher::kPlayerInfoUrl =
-    "https://scrambled-api.mysportsfeeds.com/<version>/pull/nba/"
-    "players.json?"; // player=jordan-poole
+    "<players-base>/<version>/pull/nba/players.json?"; // player=jordan-poole
+const size_t PlayerFetcher::kDecodeChunkSize = 256;
+const size_t PlayerFetcher::kDefaultLogCacheBytes = 32 << 20;
 
 PlayerFetcher::PlayerFetcher(CurlFetch *curl_fetch, TeamFetcher *team_fetcher,
                              endpoint::Options *options)
-    : curl_fetch_(curl_fetch), team_fetcher_(team_fetcher) {
+    : cache_(kDefaultLogCacheBytes), live_ttl_(TeamFetcher::kDefaultLiveTtl),
+      curl_fetch_(curl_fetch), team_fetcher_(team_fetcher) {
   if (options != nullptr) {
     options_ = *options;
   } else {
@@ -50,6 +60,7 @@ bool PlayerFetcher::AddPlayer(const PlayerFetcher::PlayerInfoShort &player_info,
     return added;
   }
 
+  std::lock_guard<std::mutex> lock(mutex_);
   for (auto log_fetch : player_log_fetches_) {
     if (log_fetch.fetch_options == used_options) {
       log_fetch.roster = std::vector(1, player_info);
@@ -73,6 +84,7 @@ void PlayerFetcher::AddToRoster(
     const std::vector<PlayerFetcher::PlayerInfoShort> &roster,
     endpoint::Options *options) {
   auto used_options = (options == nullptr ? GetDefaultOptions() : *options);
+  std::lock_guard<std::mutex> lock(mutex_);
   auto it = find_if(player_log_fetches_.begin(), player_log_fetches_.end(),
                     [&](const PlayerLogFetch log_fetch) {
                       return log_fetch.fetch_options == used_options;
@@ -106,64 +118,51 @@ PlayerFetcher::GetPlayerLog(const PlayerFetcher::PlayerInfoShort &player,
 
   // If we have an id, we check if we already have this player log (with the
   // given options) inside the cache. Avoids doing curl calls everytime.
-  auto id_iter = cache_.find(player.id);
-  if (id_iter == cache_.end()) {
-    // Do API call to retrieve the daily log.
-    auto daily_player_log = retrieve_daily_player_log(player, &used_options);
-    cache_[daily_player_log.player_info.id] =
-        std::vector(1, std::make_pair(used_options, daily_player_log));
-    return daily_player_log;
-  } else {
-    for (const auto &log_pair : id_iter->second) {
-      if (log_pair.first == used_options) {
-        return log_pair.second;
-      }
-    }
-    // This means we have a log (could be multiple) for the given player but not
-    // with the given fetch options (e.g. could be for a different date).
-    auto daily_player_log = retrieve_daily_player_log(player, &used_options);
-    id_iter->second.push_back(std::make_pair(used_options, daily_player_log));
+  DailyPlayerLog daily_player_log;
+  if (find_cached_log(player.id, used_options, &daily_player_log)) {
     return daily_player_log;
   }
+  // Do API call to retrieve the daily log. We may have a log (could be
+  // multiple) for the given player but not with the given fetch options (e.g.
+  // could be for a different date).
+  daily_player_log = retrieve_daily_player_log(player, &used_options);
+  cache_log(used_options, daily_player_log);
+  return daily_player_log;
 }
 
 std::vector<PlayerFetcher::DailyPlayerLog>
 PlayerFetcher::GetRosterLog(endpoint::Options *options) {
   std::vector<DailyPlayerLog> daily_logs;
   auto used_options = (options == nullptr ? GetDefaultOptions() : *options);
-  // Find the roster for the log fetch request that has the given options.
-  auto it = find_if(player_log_fetches_.begin(), player_log_fetches_.end(),
-                    [&](const PlayerLogFetch &log_fetch) {
-                      return log_fetch.fetch_options == used_options;
-                    });
-  if (it == player_log_fetches_.end()) {
-    return daily_logs;
+  // Find the roster for the log fetch request that has the given options. The
+  // roster is copied, since other calls may add to it in the meantime.
+  std::vector<PlayerInfoShort> roster;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = find_if(player_log_fetches_.begin(), player_log_fetches_.end(),
+                      [&](const PlayerLogFetch &log_fetch) {
+                        return log_fetch.fetch_options == used_options;
+                      });
+    if (it == player_log_fetches_.end()) {
+      return daily_logs;
+    }
+    roster = it->roster;
   }
 
   // Find any player that isn't found in the cache, we will need to retrieve
   // them. Any other player can simply be returned.
   std::vector<PlayerInfoShort> missing_players;
-  for (const auto &player : it->roster) {
+  for (const auto &player : roster) {
     if (player.id == -1) {
       // We skip the cache for players without a valid id.
       daily_logs.push_back(retrieve_daily_player_log(player, &used_options));
       continue;
     }
-    auto cache_entry_it = cache_.find(player.id);
-    if (cache_entry_it == cache_.end()) {
-      missing_players.push_back(player);
+    DailyPlayerLog daily_player_log;
+    if (find_cached_log(player.id, used_options, &daily_player_log)) {
+      daily_logs.push_back(daily_player_log);
     } else {
-      auto player_fetched_it = std::find_if(
-          cache_entry_it->second.begin(), cache_entry_it->second.end(),
-          [&](const std::pair<endpoint::Options, DailyPlayerLog>
-                  player_fetched) {
-            return player_fetched.first == used_options;
-          });
-      if (player_fetched_it == cache_entry_it->second.end()) {
-        missing_players.push_back(player);
-      } else {
-        daily_logs.push_back(player_fetched_it->second);
-      }
+      missing_players.push_back(player);
     }
   }
 
@@ -176,46 +175,161 @@ PlayerFetcher::GetRosterLog(endpoint::Options *options) {
       retrieve_daily_player_logs(missing_players, &used_options);
   // Store the players into the cache and add them to the returned vector.
   for (const auto &player : daily_player_logs) {
-    auto cache_entry_it = cache_.find(player.player_info.id);
-    auto fetched_player = std::make_pair(used_options, player);
-    if (cache_entry_it == cache_.end()) {
-      cache_[player.player_info.id] = std::vector(1, fetched_player);
-    } else {
-      cache_[player.player_info.id].push_back(fetched_player);
-    }
+    cache_log(used_options, player);
     daily_logs.push_back(player);
   }
   return daily_logs;
 }
 
+bool PlayerFetcher::GetAllPlayerLogs(endpoint::Options *options,
+                                     std::vector<DailyPlayerLog> *daily_logs) {
+  auto used_options = (options == nullptr ? GetDefaultOptions() : *options);
+  // Without a player list, the endpoint returns the logs of every player.
+  auto fetch =
+      fetch_daily_logs(make_base_daily_log_url(&used_options), &used_options);
+  if (fetch.curl_code || fetch.games_curl_code) {
+    return false;
+  }
+  for (const auto &daily_player_log : fetch.daily_logs) {
+    cache_log(used_options, daily_player_log);
+  }
+  *daily_logs = std::move(fetch.daily_logs);
+  return true;
+}
+
+size_t PlayerFetcher::LogCacheKeyHash::operator()(
+    const LogCacheKey &key) const {
+  // Player ids and dates both fit in 32 bits.
+  const uint64_t packed =
+      (static_cast<uint64_t>(static_cast<uint32_t>(key.player_id)) << 32) |
+      static_cast<uint32_t>(key.date);
+  size_t hash = std::hash<uint64_t>()(packed);
+  // Mixed as in boost::hash_combine.
+  for (const size_t value : {std::hash<Symbol>()(key.season_start),
+                             std::hash<Symbol>()(key.version),
+                             static_cast<size_t>(key.strict_search)}) {
+    hash ^= value + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+  }
+  return hash;
+}
+
+bool PlayerFetcher::make_cache_key(int player_id,
+                                   const endpoint::Options &options,
+                                   bool intern, LogCacheKey *key) {
+  if (options.date.size() != 8) {
+    return false;
+  }
+  int32_t date = 0;
+  for (const char digit : options.date) {
+    if (digit < '0' || digit > '9') {
+      return false;
+    }
+    date = date * 10 + (digit - '0');
+  }
+  key->player_id = player_id;
+  key->date = date;
+  key->strict_search = options.strict_search;
+  if (intern) {
+    key->season_start = Symbol(options.season_start);
+    key->version = Symbol(options.version);
+    return true;
+  }
+  return Symbol::Find(options.season_start, &key->season_start) &&
+         Symbol::Find(options.version, &key->version);
+}
+
+bool PlayerFetcher::find_cached_log(int player_id,
+                                    const endpoint::Options &options,
+                                    DailyPlayerLog *daily_player_log) {
+  LogCacheKey key;
+  if (!make_cache_key(player_id, options, false, &key)) {
+    return false;
+  }
+  const auto now = TeamFetcher::Clock::now();
+  CachedLog cached;
+  if (!cache_.Find(key, &cached, [now](const CachedLog &cached_log) {
+        return cached_log.expires_at > now;
+      })) {
+    return false;
+  }
+  *daily_player_log = cached.daily_player_log;
+  return true;
+}
+
+void PlayerFetcher::cache_log(const endpoint::Options &options,
+                              const DailyPlayerLog &daily_player_log) {
+  if (daily_player_log.stale) {
+    // The next fetch gets the refreshed log instead.
+    return;
+  }
+  LogCacheKey key;
+  if (!make_cache_key(daily_player_log.player_info.id, options, true, &key)) {
+    return;
+  }
+  CachedLog cached;
+  cached.expires_at = TeamFetcher::CacheExpiry(
+      daily_player_log.game_info.status(), live_ttl_);
+  if (cached.expires_at <= TeamFetcher::Clock::now()) {
+    return;
+  }
+  cached.daily_player_log = daily_player_log;
+  // Concurrent calls may have fetched the same log, the last one is kept.
+  cache_.Insert(key, cached, log_bytes(daily_player_log));
+}
+
+size_t PlayerFetcher::log_bytes(const DailyPlayerLog &daily_player_log) {
+  size_t bytes = sizeof(CachedLog);
+  // Short urls are stored inside the string.
+  const auto &img_url = daily_player_log.player_info.img_url;
+  if (img_url.capacity() > std::string().capacity()) {
+    bytes += img_url.capacity() + 1;
+  }
+  return bytes;
+}
+
 void PlayerFetcher::GetPlayerInfoShort(
     PlayerFetcher::PlayerInfoShort *player_info, endpoint::Options *options) {
   if (player_info->is_empty()) {
     return;
   }
-  auto used_options = (options == nullptr ? GetDefaultOptions() : *options);
-  const std::string endpoint_url = make_base_player_info_url(&used_options) +
-                                   make_player_list_url(*player_info);
-  std::string json_content = curl_fetch_->GetContent(endpoint_url);
+  read_player_info(make_player_list_url(*player_info), options, player_info);
+}
 
-  // Check if we had an error during the curl call.
-  if (curl_fetch_->curl_ret()) {
+void PlayerFetcher::GetPlayerInfoShort(
+    const std::string &first_name, const std::string &last_name,
+    PlayerFetcher::PlayerInfoShort *player_info) {
+  if (first_name.empty() && last_name.empty()) {
     return;
   }
+  std::string player_url = "player=";
+  add_names_to_list_url(first_name, last_name, &player_url);
+  player_url += ",";
+  read_player_info(player_url, nullptr, player_info);
+}
 
-  using json = nlohmann::json;
-  // Check if valid json content.
-  if (!json::accept(json_content)) {
+void PlayerFetcher::read_player_info(
+    const std::string &player_list_url, endpoint::Options *options,
+    PlayerFetcher::PlayerInfoShort *player_info) {
+  auto used_options = (options == nullptr ? GetDefaultOptions() : *options);
+  const std::string endpoint_url =
+      make_base_player_info_url(&used_options) + player_list_url;
+  auto response = curl_fetch_->GetResponse(endpoint_url);
+
+  // Check if we had an error during the curl call.
+  if (response.curl_code) {
     return;
   }
-  json data = json::parse(json_content);
-  if (data.empty() || !data.contains("players")) {
+
+  // Parse straight from the response buffer, invalid json content is
+  // discarded instead of throwing.
+  JsonDocument document;
+  if (!document.Parse(*response.body) || !document.root().contains("players")) {
     return;
   }
   // We'll guess that the intended player is the first one returned.
   // TODO: Update this to verify that we selected the intended player.
-  auto const &players = data["players"];
-  if (players.size() == 0) {
+  const auto players = document.root()["players"].items();
+  if (players.empty()) {
     return;
   }
   player_info->read_json(players.front());
@@ -256,36 +370,38 @@ void PlayerFetcher::add_player_to_list_url(
     // TODO: Decide if we want to handle errors with 0 or negative numbers.
     *player_list_url += std::to_string(player.id);
   } else {
-    if (!player.first_name.empty()) {
-      (*player_list_url) += player.first_name + "-";
-    }
-    if (!player.last_name.empty()) {
-      (*player_list_url) += player.last_name + "-";
-    }
-
-    if (player_list_url->back() == '-') {
-      player_list_url->erase(player_list_url->size() - 1);
-    }
+    add_names_to_list_url(player.first_name, player.last_name,
+                          player_list_url);
   }
   (*player_list_url) += ",";
 }
 
-std::string PlayerFetcher::make_base_daily_log_url(endpoint::Options *options) {
-  std::string version;
-  std::string season_start;
-  std::string date;
-  if (options == nullptr) {
-    version = options->version;
-    season_start = options->season_start;
-    date = options->date;
-  } else {
-    version = options_.version;
-    season_start = options_.season_start;
-    date = options_.date;
+void PlayerFetcher::add_names_to_list_url(const std::string &first_name,
+                                          const std::string &last_name,
+                                          std::string *player_list_url) {
+  if (!first_name.empty()) {
+    (*player_list_url) += first_name + "-";
+  }
+  if (!last_name.empty()) {
+    (*player_list_url) += last_name + "-";
+  }
+
+  if (player_list_url->back() == '-') {
+    player_list_url->erase(player_list_url->size() - 1);
   }
-  return replace(replace(replace(kDailyPlayerLogUrl, "<version>", version),
-                         "<season-start>", season_start),
-                 "<date>", date);
+}
+
+std::string PlayerFetcher::make_base_daily_log_url(endpoint::Options *options) {
+  const auto used_options =
+      (options == nullptr ? GetDefaultOptions() : *options);
+  const std::string &version = used_options.version;
+  const std::string &season_start = used_options.season_start;
+  const std::string &date = used_options.date;
+  return replace(
+      replace(replace(endpoint::resolve_base_url(kDailyPlayerLogUrl),
+                      "<version>", version),
+              "<season-start>", season_start),
+      "<date>", date);
 }
 
 std::string
@@ -294,130 +410,126 @@ PlayerFetcher::make_base_player_info_url(endpoint::Options *options) {
   if (options != nullptr) {
     version = options->version;
   } else {
-    version = options_.version;
+    version = GetDefaultOptions().version;
   }
-  return replace(kPlayerInfoUrl, "<version>", version);
+  return replace(endpoint::resolve_base_url(kPlayerInfoUrl), "<version>",
+                 version);
 }
 
-std::vector<PlayerFetcher::DailyPlayerLog>
-PlayerFetcher::construct_player_logs(const std::string &curl_response,
-                                     endpoint::Options *options) {
-  std::vector<DailyPlayerLog> daily_player_logs;
-  using json = nlohmann::json;
-  // Check if valid json content.
-  if (!json::accept(curl_response)) {
-    return daily_player_logs;
+std::shared_ptr<const DecodedDailyLog>
+PlayerFetcher::read_daily_log(const std::string &url,
+                              const CurlFetch::Response &response) {
+  auto *cache = curl_fetch_->revalidation_cache();
+  if (cache != nullptr && response.cache_version != 0) {
+    // The body didn't change since we last decoded it, reuse those logs.
+    auto decoded =
+        cache->GetParsed<DecodedDailyLog>(url, response.cache_version);
+    if (decoded != nullptr) {
+      return decoded;
+    }
+  }
+  // Decode straight from the response buffer, in a single pass. Invalid json
+  // content is discarded instead of throwing.
+  auto decoded = std::make_shared<DecodedDailyLog>();
+  if (!DailyLogDecoder::Decode(*response.body, decode_pool_, decoded.get())) {
+    return std::make_shared<const DecodedDailyLog>();
+  }
+  if (cache != nullptr && response.cache_version != 0) {
+    cache->StoreParsed<DecodedDailyLog>(url, response.cache_version, decoded);
   }
-  json data = json::parse(curl_response);
+  return decoded;
+}
 
-  // Isolate each type of data for the player daily log.
-  const auto &game_logs = get_game_logs(data);
-  if (game_logs.empty()) {
+std::vector<PlayerFetcher::DailyPlayerLog> PlayerFetcher::construct_player_logs(
+    const DecodedDailyLog &data,
+    const std::vector<TeamFetcher::GameMatchup> &game_refs) {
+  std::vector<DailyPlayerLog> daily_player_logs;
+  if (data.game_logs.empty() || data.player_references.empty() ||
+      game_refs.empty()) {
     return daily_player_logs;
   }
-  const auto &player_refs = get_player_references(data);
-  if (player_refs.empty()) {
+  // NOTE: The game/score data is retrieved using a different endpoint.
+  // Therefore, we use the TeamFetcher to do get it, then we index the games by
+  // event id to find the corresponding game of each player log.
+  std::unordered_map<int, const TeamFetcher::GameMatchup *> games;
+  games.reserve(game_refs.size());
+  for (const auto &matchup : game_refs) {
+    games.emplace(matchup.event_id, &matchup);
+  }
+  const size_t log_count = data.game_logs.size();
+  if (decode_pool_ == nullptr || log_count <= kDecodeChunkSize) {
+    daily_player_logs.reserve(log_count);
+    join_player_logs(data, games, 0, log_count, &daily_player_logs);
     return daily_player_logs;
   }
-  const auto &game_refs = team_fetcher_->GetGameReferences(options);
-  if (game_refs.empty()) {
-    return daily_player_logs;
+  // Each chunk is joined into its own list, the lists are then appended in
+  // the order of the chunks.
+  std::vector<std::vector<DailyPlayerLog>> chunks(
+      (log_count + kDecodeChunkSize - 1) / kDecodeChunkSize);
+  decode_pool_->ParallelFor(
+      log_count, kDecodeChunkSize, [&](size_t begin, size_t end) {
+        auto &chunk = chunks[begin / kDecodeChunkSize];
+        chunk.reserve(end - begin);
+        join_player_logs(data, games, begin, end, &chunk);
+      });
+  daily_player_logs.reserve(log_count);
+  for (auto &chunk : chunks) {
+    std::move(chunk.begin(), chunk.end(),
+              std::back_inserter(daily_player_logs));
   }
+  return daily_player_logs;
+}
+
+void PlayerFetcher::join_player_logs(
+    const DecodedDailyLog &data,
+    const std::unordered_map<int, const TeamFetcher::GameMatchup *> &games,
+    size_t begin, size_t end, std::vector<DailyPlayerLog> *daily_player_logs) {
   // For each game log, retrieve the other types of data. Skip incomplete game
   // logs that don't have corresponding data.
-  for (const auto &game_log : game_logs) {
-    if (!game_log.contains("player") || !game_log["player"].contains("id")) {
+  for (size_t i = begin; i < end; ++i) {
+    const auto &game_log = data.game_logs[i];
+    const auto game = games.find(game_log.game_event_id);
+    if (game == games.end()) {
       continue;
     }
     DailyPlayerLog daily_player_log;
-    const int &id = game_log["player"]["id"];
-    const auto &player_ref = find_player_reference(player_refs, id);
-    daily_player_log.player_info = PlayerIdentity::deserialize_json(player_ref);
-    daily_player_log.player_log = PlayerLog::deserialize_json(game_log);
-
-    // NOTE: The game/score data is retrieved using a different endpoint.
-    // Therefore, we use the TeamFetcher to do get it, then we find the
-    // corresponding game for this player log.
-    auto it = find_if(game_refs.begin(), game_refs.end(),
-                      [&](const TeamFetcher::GameMatchup &matchup) {
-                        return matchup.event_id ==
-                               daily_player_log.player_log.game_event_id;
-                      });
-    if (it == game_refs.end()) {
-      continue;
+    const auto *player = get_player_reference(data, game_log.player_id);
+    if (player != nullptr) {
+      daily_player_log.player_info = *player;
     }
-    daily_player_log.game_info = *it;
-    daily_player_logs.push_back(daily_player_log);
+    daily_player_log.player_log = game_log;
+    daily_player_log.game_info = *game->second;
+    daily_player_logs->push_back(daily_player_log);
   }
-  return daily_player_logs;
 }
 
-nlohmann::json
-PlayerFetcher::get_game_logs(const nlohmann::json &json_daily_log) {
-  const auto &game_logs_iter = json_daily_log.find("gamelogs");
-  if (game_logs_iter == json_daily_log.end()) {
-    return nlohmann::json();
+PlayerFetcher::PlayerLog
+PlayerFetcher::PlayerLog::deserialize_json(const JsonValue &game_log) {
+  PlayerLog log;
+  if (!game_log.contains("stats")) {
+    return log;
   }
-  return *game_logs_iter;
+  feed_schema::decode_fields(game_log, feed_schema::kPlayerLogFields, &log);
+  return log;
 }
 
-nlohmann::json
-PlayerFetcher::get_player_references(const nlohmann::json &json_daily_log) {
-  if (!json_daily_log.contains("references")) {
-    return nlohmann::json();
-  }
-  const auto &player_refs_iter =
-      json_daily_log["references"].find("playerReferences");
-  if (player_refs_iter == json_daily_log["references"].end()) {
-    return nlohmann::json();
-  }
-  return *player_refs_iter;
-}
-
-nlohmann::json PlayerFetcher::get_game_log(const nlohmann::json &json_daily_log,
-                                           int player_id) {
-  const auto &game_logs = get_game_logs(json_daily_log);
-  for (const auto &game_log : game_logs) {
-    if (game_log.contains("player") && game_log["player"].contains("id") &&
-        game_log["player"]["id"] == player_id) {
-      return game_log;
-    }
+const PlayerFetcher::PlayerLog *
+PlayerFetcher::get_game_log(const DecodedDailyLog &daily_log, int player_id) {
+  const auto it = daily_log.game_log_index.find(player_id);
+  if (it == daily_log.game_log_index.end()) {
+    return nullptr;
   }
-  return nlohmann::json();
+  return &daily_log.game_logs[it->second];
 }
 
-nlohmann::json
-PlayerFetcher::get_player_reference(const nlohmann::json &json_daily_log,
+const PlayerFetcher::PlayerIdentity *
+PlayerFetcher::get_player_reference(const DecodedDailyLog &daily_log,
                                     int player_id) {
-  const auto &player_refs = get_player_references(json_daily_log);
-  for (const auto &player_ref : player_refs) {
-    if (player_ref.contains("id") && player_ref["id"] == player_id) {
-      return player_ref;
-    }
-  }
-  return nlohmann::json();
-}
-
-nlohmann::json PlayerFetcher::find_game_log(const nlohmann::json &game_logs,
-                                            int player_id) {
-  for (const auto &game_log : game_logs) {
-    if (game_log.contains("player") && game_log["player"].contains("id") &&
-        game_log["player"]["id"] == player_id) {
-      return game_log;
-    }
-  }
-  return nlohmann::json();
-}
-
-nlohmann::json
-PlayerFetcher::find_player_reference(const nlohmann::json &player_refs,
-                                     int player_id) {
-  for (const auto &player_ref : player_refs) {
-    if (player_ref.contains("id") && player_ref["id"] == player_id) {
-      return player_ref;
-    }
+  const auto it = daily_log.player_reference_index.find(player_id);
+  if (it == daily_log.player_reference_index.end()) {
+    return nullptr;
   }
-  return nlohmann::json();
+  return &daily_log.player_references[it->second];
 }
 
 PlayerFetcher::DailyPlayerLog PlayerFetcher::retrieve_daily_player_log(
@@ -425,20 +537,15 @@ PlayerFetcher::DailyPlayerLog PlayerFetcher::retrieve_daily_player_log(
   // Construct endpoint url and do curl operation.
   const std::string daily_log_endpoint_url =
       make_base_daily_log_url(options) + make_player_list_url(player);
-  std::string json_content = curl_fetch_->GetContent(daily_log_endpoint_url);
+  auto fetch = fetch_daily_logs(daily_log_endpoint_url, options);
 
   // Check if we had an error during the curl call.
-  if (curl_fetch_->curl_ret()) {
+  if (fetch.curl_code) {
     return DailyPlayerLog::MakeFaultyLog(2);
   }
-
-  // Create the daily player log object by reading the json content response
-  // returned by the MySportsFeed endpoint.
-  auto used_options = (options == nullptr ? GetDefaultOptions() : *options);
-  auto daily_player_logs = construct_player_logs(json_content, &used_options);
   // We should only have one log since we requested only one player id.
-  if (daily_player_logs.size() == 1) {
-    return daily_player_logs.front();
+  if (fetch.daily_logs.size() == 1) {
+    return fetch.daily_logs.front();
   }
   return DailyPlayerLog::MakeFaultyLog(3);
 }
@@ -450,19 +557,74 @@ PlayerFetcher::retrieve_daily_player_logs(
   // Construct endpoint url and do curl operation.
   const std::string daily_log_endpoint_url =
       make_base_daily_log_url(options) + make_player_list_url(roster);
-  std::string json_content = curl_fetch_->GetContent(daily_log_endpoint_url);
+  return fetch_daily_logs(daily_log_endpoint_url, options).daily_logs;
+}
 
-  // Check if we had an error during the curl call.
-  if (curl_fetch_->curl_ret()) {
-    return std::vector<PlayerFetcher::DailyPlayerLog>();
+PlayerFetcher::DailyLogsFetch
+PlayerFetcher::fetch_daily_logs(const std::string &daily_log_endpoint_url,
+                                endpoint::Options *options) {
+  auto fetch_logs = [&]() {
+    // NOTE: The game/score data is retrieved using a different endpoint. We
+    // start that call first so that it overlaps with the daily log call.
+    auto used_options = (options == nullptr ? GetDefaultOptions() : *options);
+    DailyLogsFetch fetch;
+    auto game_refs = team_fetcher_->GetGameReferencesAsync(
+        &used_options, &fetch.games_curl_code);
+
+    auto response = curl_fetch_->GetResponse(daily_log_endpoint_url);
+    fetch.curl_code = response.curl_code;
+    if (fetch.curl_code == CURLE_OK && response.http_code >= 400) {
+      // e.g. the endpoint is overloaded, the body has no logs.
+      fetch.curl_code = CURLE_HTTP_RETURNED_ERROR;
+    }
+    if (fetch.curl_code) {
+      return fetch;
+    }
+
+    // NOTE: The game references are resolved first, so that their own wait
+    // and parse aren't counted as the daily log parse.
+    const auto matchups = game_refs.get();
+
+    // Create the daily player log objects by reading the json content
+    // response returned by the MySportsFeed endpoint.
+    const auto start = CurlFetch::Clock::now();
+    auto data = read_daily_log(daily_log_endpoint_url, response);
+    fetch.daily_logs = construct_player_logs(*data, matchups);
+    curl_fetch_->RecordTiming(
+        daily_log_endpoint_url, CurlFetch::Phase::kParse,
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            CurlFetch::Clock::now() - start)
+            .count());
+    for (auto &daily_log : fetch.daily_logs) {
+      daily_log.stale = response.stale;
+    }
+    return fetch;
+  };
+  if (curl_fetch_->CanServeStale(daily_log_endpoint_url)) {
+    // Don't wait on the call in flight, the last good logs are served.
+    return fetch_logs();
   }
+  return in_flight_.Do(daily_log_endpoint_url, fetch_logs);
+}
 
-  // Create the daily player log object by reading the json content response
-  // returned by the MySportsFeed endpoint.
-  auto used_options = (options == nullptr ? GetDefaultOptions() : *options);
-  auto daily_player_logs = construct_player_logs(json_content, &used_options);
-  return daily_player_logs;
+endpoint::Options PlayerFetcher::GetDefaultOptions() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return options_;
 }
 
-endpoint::Options PlayerFetcher::GetDefaultOptions() { return options_; }
+void PlayerFetcher::SetDecodePool(ThreadPool *decode_pool) {
+  decode_pool_ = decode_pool;
+}
+
+void PlayerFetcher::SetLogCacheBytes(size_t max_bytes) {
+  cache_.SetMaxBytes(max_bytes);
+}
+
+TinyLfuCacheStats PlayerFetcher::GetLogCacheStats() {
+  return cache_.GetStats();
+}
+
+void PlayerFetcher::SetLiveTtl(std::chrono::milliseconds live_ttl) {
+  live_ttl_ = live_ttl;
+}
 } // namespace fantasy_ball
\ No newline at end of file
@@ -1,20 +1,33 @@
 #ifndef PLAYER_FETCHER_H_
 #define PLAYER_FETCHER_H_
 
-#include <nlohmann/json.hpp>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <unordered_map>
 #include <utility>
 #include <vector>
 
+#include "curl_fetch.h"
+#include "json_value.h"
+#include "single_flight.h"
+#include "symbol_table.h"
 #include "team_fetcher.h"
+#include "thread_pool.h"
+#include "tiny_lfu_cache.h"
 #include "util.h"
 
 namespace fantasy_ball {
-class CurlFetch;
+
+struct DecodedDailyLog;
 
 // This class retrieves player data (statistics) from various APIs (currently
 // only MySportsFeed).
+// NOTE: Thread safe, the rosters and the cache are guarded by mutexes that are
+// never held during the endpoint calls.
 class PlayerFetcher {
 public:
   struct PlayerIdentity {
@@ -22,10 +35,10 @@ public:
     // requests. We should create a separate struct just for this use case
     // without the unused fields.
     PlayerIdentity() = default;
-    std::string first_name;
-    std::string last_name;
+    Symbol first_name;
+    Symbol last_name;
     std::string img_url;
-    std::string position;
+    Symbol position;
 
     // A negative id signifies that an error occured when creating this object
     // and should be recreated.
@@ -34,28 +47,26 @@ public:
     // Reads a single playerReferences json item into the player_identity
     // object.
     // NOTE: Expects safety checks outside and before this function call.
-    static PlayerIdentity
-    deserialize_json(const nlohmann::json &player_reference) {
+    static PlayerIdentity deserialize_json(const JsonValue &player_reference) {
       PlayerIdentity player;
       if (!player_reference.contains("id")) {
         return player;
       }
-      player.id = player_reference["id"].get<int>();
-      player.first_name = player_reference["firstName"].get<std::string>();
-      player.last_name = player_reference["lastName"].get<std::string>();
+      player.id = player_reference["id"].get_int();
+      player.first_name = player_reference["firstName"].get_string();
+      player.last_name = player_reference["lastName"].get_string();
       // Some players do not have an image source (may be because they're new
       // players). TODO: Insert a default image source for those that don't have
       // an image assigned them.
       if (!player_reference["officialImageSrc"].is_null()) {
-        player.img_url =
-            player_reference["officialImageSrc"].get<std::string>();
+        player.img_url = player_reference["officialImageSrc"].get_string();
       }
 
       // NOTE: Right now, we can only retrieve the primary position, meaning, a
       // player might be able to play multiple positions but the API doesn't
       // return it.
       // TODO: Figure out if we can get secondary positions.
-      player.position = player_reference["primaryPosition"].get<std::string>();
+      player.position = player_reference["primaryPosition"].get_string();
       return player;
     }
   };
@@ -92,41 +103,7 @@ public:
     // object. NOTE: Expects that safety checks on jthe son_content were done
     // outside and before this function call. Also, this expects a single
     // gamelogs json item in the json_content.
-    static PlayerLog deserialize_json(const nlohmann::json &game_log) {
-      PlayerLog log;
-      if (!game_log.contains("stats")) {
-        return log;
-      }
-      if (game_log.contains("game")) {
-        log.game_event_id = game_log["game"]["id"];
-      }
-      const auto &stats = game_log["stats"];
-      log.seconds_played = stats["miscellaneous"]["minSeconds"].get<int>();
-      log.field_goals_made = stats["fieldGoals"]["fgMade"].get<int>();
-      log.field_goals_attempt = stats["fieldGoals"]["fgAtt"].get<int>();
-      log.field_goal_percentage = stats["fieldGoals"]["fgPct"].get<float>();
-      log.three_points_made = stats["fieldGoals"]["fg3PtMade"].get<int>();
-      log.three_points_attempt = stats["fieldGoals"]["fg3PtAtt"].get<int>();
-      log.three_points_percentage =
-          stats["fieldGoals"]["fg3PtPct"].get<float>();
-      log.two_points_made = stats["fieldGoals"]["fg2PtMade"].get<int>();
-      log.two_points_attempt = stats["fieldGoals"]["fg2PtAtt"].get<int>();
-      log.two_points_percentage = stats["fieldGoals"]["fg2PtPct"].get<float>();
-      log.free_throws_made = stats["freeThrows"]["ftMade"].get<int>();
-      log.free_throws_attempt = stats["freeThrows"]["ftAtt"].get<int>();
-      log.free_throws_percentage = stats["freeThrows"]["ftPct"].get<float>();
-      log.offensive_rebounds = stats["rebounds"]["offReb"].get<int>();
-      log.defensive_rebounds = stats["rebounds"]["defReb"].get<int>();
-      log.total_rebounds = stats["rebounds"]["reb"].get<int>();
-      log.assists = stats["offense"]["ast"].get<int>();
-      log.steals = stats["defense"]["stl"].get<int>();
-      log.blocks = stats["defense"]["blk"].get<int>();
-      log.turnovers = stats["defense"]["tov"].get<int>();
-      log.personal_fouls = stats["miscellaneous"]["fouls"].get<int>();
-      log.points = stats["offense"]["pts"].get<int>();
-      log.player_id = game_log["player"]["id"].get<int>();
-      return log;
-    }
+    static PlayerLog deserialize_json(const JsonValue &game_log);
   };
 
   struct DailyPlayerLog {
@@ -135,6 +112,10 @@ public:
     TeamFetcher::GameMatchup game_info;
     PlayerLog player_log;
 
+    // True when read from the last good daily log response, served while the
+    // endpoint was unavailable or being refreshed. Stale logs aren't cached.
+    bool stale = false;
+
     // Temporary way to handle errors in creating a daily log. Pass in a
     // negative error code to signifiy that there was an error creating this
     // object.
@@ -153,16 +134,16 @@ public:
   struct PlayerInfoShort {
     PlayerInfoShort() = default;
     static const int kDefaultId = -1;
-    std::string first_name;
-    std::string last_name;
+    Symbol first_name;
+    Symbol last_name;
     // A negative id signifies that an error occured when creating this object
     // and should be recreated.
     int id = kDefaultId;
-    std::string team;
+    Symbol team;
     int team_id;
-    std::string positions;
+    Symbol positions;
 
-    void read_json(const nlohmann::json &player_reference) {
+    void read_json(const JsonValue &player_reference) {
       if (!player_reference.contains("player") ||
           !player_reference.contains("teamAsOfDate")) {
         id = -1;
@@ -170,16 +151,16 @@ public:
       }
       const auto &player_map = player_reference["player"];
       const auto &team_map = player_reference["teamAsOfDate"];
-      id = player_map["id"].get<int>();
-      first_name = player_map["firstName"].get<std::string>();
-      last_name = player_map["lastName"].get<std::string>();
-      team = team_map["abbreviation"].get<std::string>();
-      team_id = team_map["id"].get<int>();
-      positions = player_map["primaryPosition"].get<std::string>();
+      id = player_map["id"].get_int();
+      first_name = player_map["firstName"].get_string();
+      last_name = player_map["lastName"].get_string();
+      team = team_map["abbreviation"].get_string();
+      team_id = team_map["id"].get_int();
+      positions = player_map["primaryPosition"].get_string();
     }
 
     static PlayerInfoShort
-    deserialize_json(const nlohmann::json &player_reference) {
+    deserialize_json(const JsonValue &player_reference) {
       PlayerInfoShort player;
       if (!player_reference.contains("player") ||
           !player_reference.contains("teamAsOfDate")) {
@@ -187,12 +168,12 @@ public:
       }
       const auto &player_map = player_reference["player"];
       const auto &team_map = player_reference["teamAsOfDate"];
-      player.id = player_map["id"].get<int>();
-      player.first_name = player_map["firstName"].get<std::string>();
-      player.last_name = player_map["lastName"].get<std::string>();
-      player.team = team_map["abbreviation"].get<std::string>();
-      player.team_id = team_map["id"].get<int>();
-      player.positions = player_map["primaryPosition"].get<std::string>();
+      player.id = player_map["id"].get_int();
+      player.first_name = player_map["firstName"].get_string();
+      player.last_name = player_map["lastName"].get_string();
+      player.team = team_map["abbreviation"].get_string();
+      player.team_id = team_map["id"].get_int();
+      player.positions = player_map["primaryPosition"].get_string();
       return player;
     }
 
@@ -224,6 +205,13 @@ public:
   std::vector<DailyPlayerLog>
   GetRosterLog(endpoint::Options *options = nullptr);
 
+  // Retrieves the daily logs of every player who played on the date of the
+  // options, in a single endpoint call, and adds them to the cache so that
+  // later roster fetches with the same options don't call the endpoint.
+  // Returns false if the daily log or the games endpoint call failed.
+  bool GetAllPlayerLogs(endpoint::Options *options,
+                        std::vector<DailyPlayerLog> *daily_logs);
+
   // Updates the date parameter for the daily player log endpoint.
   void SetDateForEndpoint(const std::string &date);
 
@@ -231,6 +219,24 @@ public:
   // fetched rosters.
   endpoint::Options GetDefaultOptions();
 
+  // Sets the pool that decodes and joins the large daily player logs in
+  // chunks. Without one (the default), they are decoded on the calling thread.
+  // NOTE: Should be set before the first fetch. This class doesn't have
+  // ownership of this object.
+  void SetDecodePool(ThreadPool *decode_pool);
+
+  // Sets the memory budget of the cached daily player logs, 32 MB by default.
+  // The least valuable logs are evicted if the cached ones use more.
+  void SetLogCacheBytes(size_t max_bytes);
+
+  TinyLfuCacheStats GetLogCacheStats();
+
+  // Sets how long the logs of live games are cached, 30 seconds by default.
+  // Logs of final games are cached until evicted, and logs of scheduled games
+  // aren't cached.
+  // NOTE: Should be set before the first fetch.
+  void SetLiveTtl(std::chrono::milliseconds live_ttl);
+
   // Gets the game log for the specified player, which constructs the struct
   // from an endpoint call. NOTE: Since this is a static function, it will force
   // an API call instead of checking the cache.
@@ -242,6 +248,12 @@ public:
   void GetPlayerInfoShort(PlayerInfoShort *player_info,
                           endpoint::Options *options = nullptr);
 
+  // Same as above, for names that may not match any player, e.g. sent by
+  // clients. Only the names of the player found are interned as Symbols.
+  void GetPlayerInfoShort(const std::string &first_name,
+                          const std::string &last_name,
+                          PlayerInfoShort *player_info);
+
 private:
   // Represents a single fetch request from the user to the daily player log
   // endpoint. This usually will be used to split requests based on different
@@ -256,14 +268,60 @@ private:
     std::vector<PlayerInfoShort> roster;
   };
 
+  // Result of a single daily player log endpoint call, joined with the games.
+  struct DailyLogsFetch {
+    DailyLogsFetch() = default;
+    CURLcode curl_code = CURLE_OK;
+
+    // Curl code of the games call, when the daily log call succeeded. The
+    // logs aren't joined with any game if it failed.
+    CURLcode games_curl_code = CURLE_OK;
+    std::vector<DailyPlayerLog> daily_logs;
+  };
+
+  // Guards the fetches and the options.
+  std::mutex mutex_;
+
   // List of fetches for daily player logs requests to the endpoint to process.
   std::vector<PlayerLogFetch> player_log_fetches_;
 
-  // Cache copy of the retrieved daily player logs.
-  // TODO: This can get complicated and might neeed its own class.
-  std::unordered_map<int,
-                     std::vector<std::pair<endpoint::Options, DailyPlayerLog>>>
-      cache_;
+  // Key of a cached daily player log. The date is packed as a yyyymmdd
+  // integer and the season and version are interned, so that a key is hashed
+  // and compared without reading any string.
+  struct LogCacheKey {
+    LogCacheKey() = default;
+
+    bool operator==(const LogCacheKey &rhs) const {
+      return (this->player_id == rhs.player_id) && (this->date == rhs.date) &&
+             (this->strict_search == rhs.strict_search) &&
+             (this->season_start == rhs.season_start) &&
+             (this->version == rhs.version);
+    }
+
+    int player_id;
+    int32_t date;
+    bool strict_search;
+    Symbol season_start;
+    Symbol version;
+  };
+
+  struct LogCacheKeyHash {
+    size_t operator()(const LogCacheKey &key) const;
+  };
+
+  // Cached log along with its expiry, from the status of its game.
+  struct CachedLog {
+    CachedLog() = default;
+    DailyPlayerLog daily_player_log;
+    TeamFetcher::Clock::time_point expires_at;
+  };
+
+  // Cache copy of the retrieved daily player logs, bounded by memory. Logs of
+  // the players that are requested again (e.g. the rostered ones) are kept
+  // over the ones fetched once.
+  TinyLfuCache<LogCacheKey, CachedLog, LogCacheKeyHash> cache_;
+
+  std::chrono::milliseconds live_ttl_;
 
   // Current and default options for the daily player log endpoint.
   endpoint::Options options_;
@@ -274,6 +332,14 @@ private:
   // NOTE: This class doesn't have ownership of this object.
   TeamFetcher *team_fetcher_;
 
+  // NOTE: This class doesn't have ownership of this object.
+  ThreadPool *decode_pool_ = nullptr;
+
+  // Daily player log retrievals that are in flight, keyed by endpoint url.
+  // Concurrent requests for the same players and date (e.g. many clients at
+  // tip-off) wait for a single call and share its parsed logs.
+  SingleFlight<std::string, DailyLogsFetch> in_flight_;
+
   // Constructs a string with the player list section of the MySportsFeed daily
   // log endpoint. e.g. player=lebron-james,kyrie-irving
   std::string make_player_list_url(const std::vector<PlayerInfoShort> &roster);
@@ -282,45 +348,75 @@ private:
   std::string make_player_list_url(const PlayerInfoShort &player);
   void add_player_to_list_url(const PlayerInfoShort &player,
                               std::string *player_list_url);
+  void add_names_to_list_url(const std::string &first_name,
+                             const std::string &last_name,
+                             std::string *player_list_url);
+
+  // Fills the player info with the first player returned by the player info
+  // endpoint for the given player list.
+  void read_player_info(const std::string &player_list_url,
+                        endpoint::Options *options,
+                        PlayerInfoShort *player_info);
 
   // Constructs a string with the base daily log endpoint url.
   std::string make_base_daily_log_url(endpoint::Options *options = nullptr);
 
   std::string make_base_player_info_url(endpoint::Options *options);
 
-  // Creates the player log object from a JSON string.
-  // NOTE: The string parameter should be of JSON format and should've been fed
-  // from a Curl perform call to the daily player log MySportsFeed endpoint. We
-  // also do various safety checks on the json data.
+  // Returns the game logs and player references of a daily player log
+  // endpoint response. When the endpoint confirmed that the body didn't
+  // change, the previously decoded logs are reused from the revalidation
+  // cache. Returns empty logs if the body isn't valid json.
+  std::shared_ptr<const DecodedDailyLog>
+  read_daily_log(const std::string &url, const CurlFetch::Response &response);
+
+  // Creates the player log objects from the decoded daily player log, joined
+  // with the games retrieved for the same date.
+  // NOTE: Large daily logs are joined in chunks by the decode pool, the
+  // logs keep the order of the response.
   std::vector<DailyPlayerLog>
-  construct_player_logs(const std::string &curl_response,
-                        endpoint::Options *options);
-
-  // Retrieves all game logs found in the daily player log endpoint call json
-  // object.
-  nlohmann::json get_game_logs(const nlohmann::json &json_daily_log);
-
-  // Retrieves all player references found in the daily player log endpoint call
-  // json object.
-  nlohmann::json get_player_references(const nlohmann::json &json_daily_log);
-
-  // Retrieves the game log for the specified player from a daily player log
-  // endcall json object.
-  nlohmann::json get_game_log(const nlohmann::json &json_daily_log,
-                              int player_id);
-
-  // Retrieves the player reference for the specified player from a daily player
-  // log endcall json object.
-  nlohmann::json get_player_reference(const nlohmann::json &json_daily_log,
-                                      int player_id);
-
-  // Finds the game log for the given player id, from a list of game logs.
-  nlohmann::json find_game_log(const nlohmann::json &game_logs, int player_id);
-
-  // Find the player reference for the given player id, from a list of player
-  // references.
-  nlohmann::json find_player_reference(const nlohmann::json &player_refs,
-                                       int player_id);
+  construct_player_logs(const DecodedDailyLog &data,
+                        const std::vector<TeamFetcher::GameMatchup> &game_refs);
+
+  // Joins the game logs in [begin, end) of the decoded daily player log with
+  // their player and game, appending them to the daily player logs.
+  void join_player_logs(
+      const DecodedDailyLog &data,
+      const std::unordered_map<int, const TeamFetcher::GameMatchup *> &games,
+      size_t begin, size_t end, std::vector<DailyPlayerLog> *daily_player_logs);
+
+  // Returns the game log of the given player from a decoded daily player log,
+  // or nullptr if there's none.
+  const PlayerLog *get_game_log(const DecodedDailyLog &daily_log,
+                                int player_id);
+
+  // Returns the player reference of the given player from a decoded daily
+  // player log, or nullptr if there's none.
+  const PlayerIdentity *get_player_reference(const DecodedDailyLog &daily_log,
+                                             int player_id);
+
+  // Makes the cache key of the player's log for the given options. Returns
+  // false if the date isn't in the yyyymmdd format, such logs aren't cached.
+  // Without intern, also returns false if the season or version were never
+  // interned, in which case nothing can be cached for them: lookups with
+  // client supplied options don't grow the global symbol table.
+  static bool make_cache_key(int player_id, const endpoint::Options &options,
+                             bool intern, LogCacheKey *key);
+
+  // Memory used by the log, charged against the cache budget. Names are
+  // interned, so only the image url is counted besides the struct itself.
+  static size_t log_bytes(const DailyPlayerLog &daily_player_log);
+
+  // Copies the cached log of the player for the given options. Returns false
+  // if there's none or it expired.
+  bool find_cached_log(int player_id, const endpoint::Options &options,
+                       DailyPlayerLog *daily_player_log);
+
+  // Adds the log to the cache until the expiry of its game status (see
+  // TeamFetcher::CacheExpiry), replacing any log cached for the options.
+  // Stale logs and logs of scheduled games aren't cached.
+  void cache_log(const endpoint::Options &options,
+                 const DailyPlayerLog &daily_player_log);
 
   // Retrieves the daily player log from the MySportsFeed endpoint.
   DailyPlayerLog
@@ -332,6 +428,12 @@ private:
   retrieve_daily_player_logs(const std::vector<PlayerInfoShort> &roster,
                              endpoint::Options *options);
 
+  // Calls the daily player log endpoint with the given url and joins the logs
+  // with the games of the date in the options. Identical concurrent calls
+  // are coalesced.
+  DailyLogsFetch fetch_daily_logs(const std::string &daily_log_endpoint_url,
+                                  endpoint::Options *options);
+
   // Default parameters to the daily player log endpoint.
   static const std::string kDefaultVersion;
   static const std::string kDefaultSeasonStart;
@@ -341,6 +443,10 @@ private:
   // Base url for MySportsFeed daily player log endpoint.
   static const std::string kDailyPlayerLogUrl;
   static const std::string kPlayerInfoUrl;
+
+  // Game logs decoded or joined by each task of the decode pool.
+  static const size_t kDecodeChunkSize;
+  static const size_t kDefaultLogCacheBytes;
 };
 
 } // namespace fantasy_ball
@@ -0,0 +1,144 @@
+#include "player_log_columns.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace fantasy_ball {
+using PlayerLog = PlayerFetcher::PlayerLog;
+
+const std::vector<PlayerLogColumns::CountField>
+    PlayerLogColumns::kCountFields = {
+        {Count::kSecondsPlayed, &PlayerLog::seconds_played},
+        {Count::kFieldGoalsMade, &PlayerLog::field_goals_made},
+        {Count::kFieldGoalsAttempt, &PlayerLog::field_goals_attempt},
+        {Count::kThreePointsMade, &PlayerLog::three_points_made},
+        {Count::kThreePointsAttempt, &PlayerLog::three_points_attempt},
+        {Count::kTwoPointsMade, &PlayerLog::two_points_made},
+        {Count::kTwoPointsAttempt, &PlayerLog::two_points_attempt},
+        {Count::kFreeThrowsMade, &PlayerLog::free_throws_made},
+        {Count::kFreeThrowsAttempt, &PlayerLog::free_throws_attempt},
+        {Count::kOffensiveRebounds, &PlayerLog::offensive_rebounds},
+        {Count::kDefensiveRebounds, &PlayerLog::defensive_rebounds},
+        {Count::kTotalRebounds, &PlayerLog::total_rebounds},
+        {Count::kAssists, &PlayerLog::assists},
+        {Count::kSteals, &PlayerLog::steals},
+        {Count::kBlocks, &PlayerLog::blocks},
+        {Count::kTurnovers, &PlayerLog::turnovers},
+        {Count::kPersonalFouls, &PlayerLog::personal_fouls},
+        {Count::kPoints, &PlayerLog::points},
+};
+
+const std::vector<PlayerLogColumns::PercentageField>
+    PlayerLogColumns::kPercentageFields = {
+        {Percentage::kFieldGoals, &PlayerLog::field_goal_percentage},
+        {Percentage::kThreePoints, &PlayerLog::three_points_percentage},
+        {Percentage::kTwoPoints, &PlayerLog::two_points_percentage},
+        {Percentage::kFreeThrows, &PlayerLog::free_throws_percentage},
+};
+
+void PlayerLogColumns::Append(const PlayerFetcher::DailyPlayerLog &daily_log) {
+  const auto &log = daily_log.player_log;
+  const uint64_t key = row_key(log.player_id, log.game_event_id);
+  auto row = rows_.find(key);
+  if (row == rows_.end()) {
+    row = rows_.emplace(key, player_ids_.size()).first;
+    player_ids_.push_back(log.player_id);
+    event_ids_.push_back(log.game_event_id);
+    for (auto &column : counts_) {
+      column.push_back(0);
+    }
+    for (auto &column : percentages_) {
+      column.push_back(0);
+    }
+  }
+  const size_t index = row->second;
+  for (const auto &field : kCountFields) {
+    const int value = std::clamp<int>(log.*field.member,
+                                      std::numeric_limits<int16_t>::min(),
+                                      std::numeric_limits<int16_t>::max());
+    counts_[static_cast<size_t>(field.stat)][index] =
+        static_cast<int16_t>(value);
+  }
+  for (const auto &field : kPercentageFields) {
+    const float value = std::clamp<float>(log.*field.member, 0, 100);
+    percentages_[static_cast<size_t>(field.stat)][index] =
+        static_cast<uint16_t>(std::lround(value * 100));
+  }
+  players_[log.player_id] = daily_log.player_info;
+  games_[log.game_event_id] = daily_log.game_info;
+}
+
+PlayerFetcher::DailyPlayerLog PlayerLogColumns::Get(size_t row) const {
+  PlayerFetcher::DailyPlayerLog daily_log;
+  auto &log = daily_log.player_log;
+  log.player_id = player_ids_[row];
+  log.game_event_id = event_ids_[row];
+  for (const auto &field : kCountFields) {
+    log.*field.member = counts_[static_cast<size_t>(field.stat)][row];
+  }
+  for (const auto &field : kPercentageFields) {
+    log.*field.member =
+        to_percentage(percentages_[static_cast<size_t>(field.stat)][row]);
+  }
+  daily_log.player_info = players_.at(log.player_id);
+  daily_log.game_info = games_.at(log.game_event_id);
+  return daily_log;
+}
+
+int64_t PlayerLogColumns::Find(int player_id, int event_id) const {
+  const auto row = rows_.find(row_key(player_id, event_id));
+  if (row == rows_.end()) {
+    return -1;
+  }
+  return static_cast<int64_t>(row->second);
+}
+
+const std::vector<int16_t> &PlayerLogColumns::count_column(Count stat) const {
+  return counts_[static_cast<size_t>(stat)];
+}
+
+const std::vector<uint16_t> &
+PlayerLogColumns::percentage_column(Percentage stat) const {
+  return percentages_[static_cast<size_t>(stat)];
+}
+
+const std::vector<int32_t> &PlayerLogColumns::player_ids() const {
+  return player_ids_;
+}
+
+const std::vector<int32_t> &PlayerLogColumns::event_ids() const {
+  return event_ids_;
+}
+
+float PlayerLogColumns::to_percentage(uint16_t value) {
+  return static_cast<float>(value) / 100;
+}
+
+size_t PlayerLogColumns::size() const { return player_ids_.size(); }
+
+size_t PlayerLogColumns::memory_bytes() const {
+  size_t bytes = (player_ids_.capacity() + event_ids_.capacity()) *
+                 sizeof(int32_t);
+  for (const auto &column : counts_) {
+    bytes += column.capacity() * sizeof(int16_t);
+  }
+  for (const auto &column : percentages_) {
+    bytes += column.capacity() * sizeof(uint16_t);
+  }
+  // NOTE: Hash nodes are counted as their entry and two pointers.
+  const size_t node_bytes = 2 * sizeof(void *);
+  bytes += rows_.size() * (sizeof(uint64_t) + sizeof(size_t) + node_bytes);
+  bytes += players_.size() *
+           (sizeof(int) + sizeof(PlayerFetcher::PlayerIdentity) + node_bytes);
+  bytes += games_.size() *
+           (sizeof(int) + sizeof(TeamFetcher::GameMatchup) + node_bytes);
+  return bytes;
+}
+
+uint64_t PlayerLogColumns::row_key(int player_id, int event_id) {
+  return (static_cast<uint64_t>(static_cast<uint32_t>(player_id)) << 32) |
+         static_cast<uint32_t>(event_id);
+}
+
+} // namespace fantasy_ball
@@ -0,0 +1,111 @@
+#ifndef PLAYER_LOG_COLUMNS_H_
+#define PLAYER_LOG_COLUMNS_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "player_fetcher.h"
+#include "team_fetcher.h"
+
+namespace fantasy_ball {
+
+// Compact column store of daily player logs, e.g. the logs of a whole season.
+// Every stat of the logs is kept in its own narrow column (16 bit counts and
+// fixed-point percentages), so that scanning a stat only reads that column.
+// The player and game of each log are kept once per player id and event id.
+// NOTE: Not thread safe, callers should hold their own lock.
+class PlayerLogColumns {
+public:
+  // Counted stats, stored as int16_t. Larger values are clamped.
+  enum class Count {
+    kSecondsPlayed,
+    kFieldGoalsMade,
+    kFieldGoalsAttempt,
+    kThreePointsMade,
+    kThreePointsAttempt,
+    kTwoPointsMade,
+    kTwoPointsAttempt,
+    kFreeThrowsMade,
+    kFreeThrowsAttempt,
+    kOffensiveRebounds,
+    kDefensiveRebounds,
+    kTotalRebounds,
+    kAssists,
+    kSteals,
+    kBlocks,
+    kTurnovers,
+    kPersonalFouls,
+    kPoints,
+  };
+
+  // Percentage stats, stored in hundredths of a percent (45.3 is 4530).
+  // Values outside of 0-100 are clamped.
+  enum class Percentage {
+    kFieldGoals,
+    kThreePoints,
+    kTwoPoints,
+    kFreeThrows,
+  };
+
+  PlayerLogColumns() = default;
+  ~PlayerLogColumns() = default;
+
+  // Adds the log as the last row, unless a log of the same player and game
+  // was already added, in which case that row is replaced.
+  void Append(const PlayerFetcher::DailyPlayerLog &daily_log);
+
+  // Returns the log of the given row, which should be lower than size().
+  PlayerFetcher::DailyPlayerLog Get(size_t row) const;
+
+  // Returns the row of the log of the player for the game, or -1 if there's
+  // none.
+  int64_t Find(int player_id, int event_id) const;
+
+  const std::vector<int16_t> &count_column(Count stat) const;
+  const std::vector<uint16_t> &percentage_column(Percentage stat) const;
+  const std::vector<int32_t> &player_ids() const;
+  const std::vector<int32_t> &event_ids() const;
+
+  // Reads a value of a percentage column back as a percentage.
+  static float to_percentage(uint16_t value);
+
+  size_t size() const;
+
+  // Approximate memory used by the columns and the players and games.
+  size_t memory_bytes() const;
+
+  static const size_t kCountColumns = 18;
+  static const size_t kPercentageColumns = 4;
+
+private:
+  struct CountField {
+    Count stat;
+    int PlayerFetcher::PlayerLog::*member;
+  };
+  struct PercentageField {
+    Percentage stat;
+    float PlayerFetcher::PlayerLog::*member;
+  };
+  static const std::vector<CountField> kCountFields;
+  static const std::vector<PercentageField> kPercentageFields;
+
+  std::vector<int32_t> player_ids_;
+  std::vector<int32_t> event_ids_;
+  std::array<std::vector<int16_t>, kCountColumns> counts_;
+  std::array<std::vector<uint16_t>, kPercentageColumns> percentages_;
+
+  // Row of each log, keyed by the player id and event id packed together.
+  std::unordered_map<uint64_t, size_t> rows_;
+
+  std::unordered_map<int, PlayerFetcher::PlayerIdentity> players_;
+  std::unordered_map<int, TeamFetcher::GameMatchup> games_;
+
+  static uint64_t row_key(int player_id, int event_id);
+};
+
+} // namespace fantasy_ball
+
+#endif // PLAYER_LOG_COLUMNS_H_
@@ -1,14 +1,25 @@
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
 #include <iostream>
+#include <limits>
 #include <memory>
+#include <mutex>
+#include <sstream>
 #include <string>
+#include <thread>
 
 #include <grpcpp/ext/proto_server_reflection_plugin.h>
 #include <grpcpp/grpcpp.h>
 #include <grpcpp/health_check_service_interface.h>
 
 #include "curl_fetch.h"
+#include "fetch_scheduler.h"
 #include "player_fetcher.h"
 #include "team_fetcher.h"
+#include "thread_pool.h"
 #include "util.h"
 #include <proto/player_team_service.grpc.pb.h>
 
@@ -17,6 +28,225 @@ using grpc::ServerBuilder;
 using grpc::ServerContext;
 using grpc::Status;
 
+// Default quota for each MySportsFeed endpoint family.
+static const double kDefaultRequestsPerSecond = 2;
+static const double kDefaultBurst = 4;
+
+// Flags of the service, printed along with the malformed ones.
+static const char kUsage[] =
+    "Usage: player_team_service_server [flags]\n"
+    "  --pool_size=<Curl handles shared by the concurrent calls, defaults to\n"
+    "               the number of cores and at least 8>\n"
+    "  --store_mode=<off|record|replay|read_through>\n"
+    "  --store_dir=<directory of the on-disk response store>\n"
+    "  --requests_per_second=<quota for each endpoint family, 0 for no limit>\n"
+    "  --burst=<requests allowed at once before the quota is enforced>\n"
+    "  --max_attempts=<attempts per endpoint call, retries included>\n"
+    "  --deadline_ms=<time budget of an endpoint call, 0 for no deadline>\n"
+    "  --hedging=<true|false>\n"
+    "  --circuit_breaker_failures=<consecutive failures opening the circuit\n"
+    "                              of an endpoint, 0 disables the breaker>\n"
+    "  --circuit_breaker_open_ms=<time before a probe call is let through>\n"
+    "  --serve_stale=<true|false>\n"
+    "  --msf_base_url=<base url of the endpoints, e.g. http://localhost:8089\n"
+    "                  for the msf_stub_server>\n"
+    "  --decode_threads=<threads decoding and joining the large daily player\n"
+    "                    logs, defaults to the number of cores, 0 decodes\n"
+    "                    them on the calling thread>\n"
+    "  --log_cache_mb=<memory budget of the cached daily player logs, 0\n"
+    "                  keeps the default>\n"
+    "  --live_ttl_seconds=<how long the logs and games of live games are\n"
+    "                      cached>\n"
+    "  --timings_log_seconds=<period of the timings log, 0 (the default)\n"
+    "                         disables it>\n";
+
+// Returns the value of the --<name>=<value> flag, or null if there's no such
+// flag.
+const char *find_flag(int argc, char *argv[], const std::string &name) {
+  const std::string prefix = "--" + name + "=";
+  for (int i = 1; i < argc; ++i) {
+    if (std::strncmp(argv[i], prefix.c_str(), prefix.size()) == 0) {
+      return argv[i] + prefix.size();
+    }
+  }
+  return nullptr;
+}
+
+// Reads the value of the --<name>=<value> flag, the value is left unchanged
+// if there's no such flag. Returns false, after printing the flag, if its
+// value is malformed: numbers should be non-negative, booleans true or false.
+bool flag_value(int argc, char *argv[], const std::string &name,
+                std::string *value) {
+  const char *flag = find_flag(argc, argv, name);
+  if (flag != nullptr) {
+    *value = flag;
+  }
+  return true;
+}
+
+bool flag_value(int argc, char *argv[], const std::string &name, int *value) {
+  const char *flag = find_flag(argc, argv, name);
+  if (flag == nullptr) {
+    return true;
+  }
+  int64_t parsed = 0;
+  if (!fantasy_ball::parse_int(flag, &parsed) || parsed < 0 ||
+      parsed > std::numeric_limits<int>::max()) {
+    std::cout << "Invalid --" << name << ": " << flag << std::endl;
+    return false;
+  }
+  *value = static_cast<int>(parsed);
+  return true;
+}
+
+bool flag_value(int argc, char *argv[], const std::string &name,
+                double *value) {
+  const char *flag = find_flag(argc, argv, name);
+  if (flag == nullptr) {
+    return true;
+  }
+  double parsed = 0;
+  if (!fantasy_ball::parse_double(flag, &parsed) || parsed < 0) {
+    std::cout << "Invalid --" << name << ": " << flag << std::endl;
+    return false;
+  }
+  *value = parsed;
+  return true;
+}
+
+bool flag_value(int argc, char *argv[], const std::string &name, bool *value) {
+  const char *flag = find_flag(argc, argv, name);
+  if (flag == nullptr) {
+    return true;
+  }
+  if (std::strcmp(flag, "true") != 0 && std::strcmp(flag, "false") != 0) {
+    std::cout << "Invalid --" << name << ": " << flag << std::endl;
+    return false;
+  }
+  *value = (std::strcmp(flag, "true") == 0);
+  return true;
+}
+
+// Reads the fetch configuration from the command line flags (see kUsage).
+// Returns false if one of them is malformed.
+bool fetch_config_from_flags(
+    int argc, char *argv[], fantasy_ball::CurlFetch::Config *config,
+    std::unique_ptr<fantasy_ball::FetchScheduler> *scheduler) {
+  using StoreMode = fantasy_ball::CurlFetch::StoreMode;
+  // The handlers of concurrent RPCs run on their own threads, give each core
+  // a handle.
+  int pool_size = std::max(8u, std::thread::hardware_concurrency());
+  std::string store_mode = "off";
+  double requests_per_second = kDefaultRequestsPerSecond;
+  double burst = kDefaultBurst;
+  int deadline_ms = static_cast<int>(config->retry.deadline.count());
+  int open_ms =
+      static_cast<int>(config->circuit_breaker.open_duration.count());
+  std::string msf_base_url;
+  if (!flag_value(argc, argv, "pool_size", &pool_size) ||
+      !flag_value(argc, argv, "store_mode", &store_mode) ||
+      !flag_value(argc, argv, "store_dir", &config->store_directory) ||
+      !flag_value(argc, argv, "requests_per_second", &requests_per_second) ||
+      !flag_value(argc, argv, "burst", &burst) ||
+      !flag_value(argc, argv, "max_attempts", &config->retry.max_attempts) ||
+      !flag_value(argc, argv, "deadline_ms", &deadline_ms) ||
+      !flag_value(argc, argv, "hedging", &config->retry.hedging) ||
+      !flag_value(argc, argv, "circuit_breaker_failures",
+                  &config->circuit_breaker.failure_threshold) ||
+      !flag_value(argc, argv, "circuit_breaker_open_ms", &open_ms) ||
+      !flag_value(argc, argv, "serve_stale", &config->serve_stale) ||
+      !flag_value(argc, argv, "msf_base_url", &msf_base_url)) {
+    return false;
+  }
+  config->pool_size = pool_size;
+  if (store_mode == "off") {
+    config->store_mode = StoreMode::kOff;
+  } else if (store_mode == "record") {
+    config->store_mode = StoreMode::kRecord;
+  } else if (store_mode == "replay") {
+    config->store_mode = StoreMode::kReplay;
+  } else if (store_mode == "read_through") {
+    config->store_mode = StoreMode::kReadThrough;
+  } else {
+    std::cout << "Invalid --store_mode: " << store_mode << std::endl;
+    return false;
+  }
+  config->retry.deadline = std::chrono::milliseconds(deadline_ms);
+  config->circuit_breaker.open_duration = std::chrono::milliseconds(open_ms);
+  if (!msf_base_url.empty()) {
+    fantasy_ball::endpoint::set_msf_base_url(msf_base_url);
+  }
+  if (requests_per_second > 0) {
+    *scheduler = std::make_unique<fantasy_ball::FetchScheduler>(
+        fantasy_ball::FetchScheduler::Limit(requests_per_second, burst));
+    config->scheduler = scheduler->get();
+  }
+  return true;
+}
+
+// Logs the timing summaries of every endpoint at the given period, to tell
+// whether slow calls are network, parse or cache bound. Latencies are in
+// microseconds. The counters of the player log cache are logged along. Runs on
+// its own thread until destroyed, which should happen before the fetchers are.
+class TimingsLogger {
+public:
+  TimingsLogger(fantasy_ball::CurlFetch *curl_fetch,
+                fantasy_ball::PlayerFetcher *player_fetcher,
+                std::chrono::seconds period)
+      : curl_fetch_(curl_fetch), player_fetcher_(player_fetcher),
+        period_(period), thread_(&TimingsLogger::run, this) {}
+
+  ~TimingsLogger() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+    }
+    wakeup_.notify_one();
+    thread_.join();
+  }
+
+private:
+  // NOTE: This class doesn't have ownership of this object.
+  fantasy_ball::CurlFetch *curl_fetch_;
+
+  // NOTE: This class doesn't have ownership of this object.
+  fantasy_ball::PlayerFetcher *player_fetcher_;
+
+  const std::chrono::seconds period_;
+  std::mutex mutex_;
+  std::condition_variable wakeup_;
+  bool stopping_ = false;
+  std::thread thread_;
+
+  void run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!wakeup_.wait_for(lock, period_, [this] { return stopping_; })) {
+      log();
+    }
+  }
+
+  // Writes the summaries at once, so that they aren't interleaved with the
+  // other lines of the service log.
+  void log() {
+    std::ostringstream out;
+    const auto cache = player_fetcher_->GetLogCacheStats();
+    out << "player log cache: entries=" << cache.entries
+        << " bytes=" << cache.bytes << "/" << cache.max_bytes
+        << " hits=" << cache.hits << " misses=" << cache.misses
+        << " evictions=" << cache.evictions << "\n";
+    for (const auto &endpoint : curl_fetch_->GetTimings()) {
+      for (const auto &phase : endpoint.second) {
+        const auto &summary = phase.second;
+        out << endpoint.first << " " << phase.first
+            << ": count=" << summary.count << " p50=" << summary.p50
+            << " p95=" << summary.p95 << " p99=" << summary.p99
+            << " max=" << summary.max << "\n";
+      }
+    }
+    std::cout << out.str() << std::flush;
+  }
+};
+
 fantasy_ball::endpoint::Options
 from_config(const playerteamservice::FetchConfig &config) {
   fantasy_ball::endpoint::Options options = {};
@@ -107,9 +337,8 @@ public:
       const playerteamservice::MinimalPlayerDescription *request,
       playerteamservice::PlayerDescription *reply) override {
     fantasy_ball::PlayerFetcher::PlayerInfoShort info = {};
-    info.first_name = request->first_name();
-    info.last_name = request->last_name();
-    player_fetcher_->GetPlayerInfoShort(&info);
+    player_fetcher_->GetPlayerInfoShort(request->first_name(),
+                                        request->last_name(), &info);
     if (info.id == fantasy_ball::PlayerFetcher::PlayerInfoShort::kDefaultId) {
       return Status::CANCELLED;
     }
@@ -146,11 +375,48 @@ private:
 
 int main(int argc, char *argv[]) {
 
+  // Read the flags, see kUsage.
+  std::unique_ptr<fantasy_ball::FetchScheduler> scheduler;
+  fantasy_ball::CurlFetch::Config fetch_config = {};
+  int decode_threads = std::thread::hardware_concurrency();
+  int log_cache_mb = 0;
+  int live_ttl_seconds = -1;
+  int timings_log_seconds = 0;
+  if (!fetch_config_from_flags(argc, argv, &fetch_config, &scheduler) ||
+      !flag_value(argc, argv, "decode_threads", &decode_threads) ||
+      !flag_value(argc, argv, "log_cache_mb", &log_cache_mb) ||
+      !flag_value(argc, argv, "live_ttl_seconds", &live_ttl_seconds) ||
+      !flag_value(argc, argv, "timings_log_seconds", &timings_log_seconds)) {
+    std::cout << kUsage << std::endl;
+    return 1;
+  }
+
   // Create the required fetchers.
   fantasy_ball::CurlFetch curl_fetch;
-  curl_fetch.Init();
+  if (!curl_fetch.Init(fetch_config)) {
+    std::cout << "Couldn't open the response store." << std::endl;
+    return 1;
+  }
   fantasy_ball::TeamFetcher team_fetcher(&curl_fetch);
   fantasy_ball::PlayerFetcher player_fetcher(&curl_fetch, &team_fetcher);
+  std::unique_ptr<fantasy_ball::ThreadPool> decode_pool;
+  if (decode_threads > 0) {
+    decode_pool = std::make_unique<fantasy_ball::ThreadPool>(decode_threads);
+    player_fetcher.SetDecodePool(decode_pool.get());
+  }
+  if (log_cache_mb > 0) {
+    player_fetcher.SetLogCacheBytes(static_cast<size_t>(log_cache_mb) << 20);
+  }
+  if (live_ttl_seconds >= 0) {
+    team_fetcher.SetLiveTtl(std::chrono::seconds(live_ttl_seconds));
+    player_fetcher.SetLiveTtl(std::chrono::seconds(live_ttl_seconds));
+  }
+  // NOTE: Declared after the fetchers, so that it's stopped before them.
+  std::unique_ptr<TimingsLogger> timings_logger;
+  if (timings_log_seconds > 0) {
+    timings_logger = std::make_unique<TimingsLogger>(
+        &curl_fetch, &player_fetcher, std::chrono::seconds(timings_log_seconds));
+  }
 
   // Create the server and run it.
   ServerBuilder builder;
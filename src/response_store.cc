@@ -0,0 +1,295 @@
+#include "response_store.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include <zlib.h>
+
+#include "util.h"
+
+namespace fantasy_ball {
+namespace {
+// Fixed size header found at the start of every entry file, followed by the
+// normalized url and the compressed body.
+// NOTE: Written in the native byte order, the store isn't meant to be shared
+// between machines.
+struct EntryHeader {
+  uint32_t magic;
+  uint32_t format_version;
+  uint64_t url_size;
+  uint64_t raw_size;
+  uint64_t compressed_size;
+};
+
+// Unmaps the file once the entry was read.
+class MappedFile {
+public:
+  explicit MappedFile(const std::string &path) {
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      return;
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) == 0 && file_stat.st_size > 0) {
+      void *data = mmap(nullptr, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd,
+                        0);
+      if (data != MAP_FAILED) {
+        data_ = static_cast<const char *>(data);
+        size_ = file_stat.st_size;
+        modified_at_ = std::chrono::system_clock::from_time_t(
+            file_stat.st_mtime);
+      }
+    }
+    // The mapping stays valid after the descriptor is closed.
+    close(fd);
+  }
+  ~MappedFile() {
+    if (data_ != nullptr) {
+      munmap(const_cast<char *>(data_), size_);
+    }
+  }
+
+  const char *data() const { return data_; }
+  size_t size() const { return size_; }
+  std::chrono::system_clock::time_point modified_at() const {
+    return modified_at_;
+  }
+
+private:
+  const char *data_ = nullptr;
+  size_t size_ = 0;
+  std::chrono::system_clock::time_point modified_at_;
+};
+} // namespace
+
+const uint32_t ResponseStore::kMagic = 0x53524246; // "FBRS"
+const uint32_t ResponseStore::kFormatVersion = 1;
+const uint64_t ResponseStore::kMaxRawSize = 1ULL << 30;
+// Bounds the memory held by the bodies waiting to be written.
+const size_t ResponseStore::kMaxPendingSaves = 64;
+
+ResponseStore::ResponseStore(const std::string &directory)
+    : directory_(directory) {}
+
+ResponseStore::~ResponseStore() {
+  {
+    std::lock_guard<std::mutex> lock(writer_mutex_);
+    stopping_ = true;
+  }
+  writer_wakeup_.notify_all();
+  if (writer_.joinable()) {
+    writer_.join();
+  }
+}
+
+bool ResponseStore::Init() {
+  std::error_code error;
+  std::filesystem::create_directories(directory_, error);
+  return std::filesystem::is_directory(directory_, error);
+}
+
+bool ResponseStore::Load(const std::string &url, std::string *body) {
+  std::chrono::system_clock::time_point saved_at;
+  return Load(url, body, &saved_at);
+}
+
+bool ResponseStore::Load(const std::string &url, std::string *body,
+                         std::chrono::system_clock::time_point *saved_at) {
+  const std::string normalized_url = normalize_url(url);
+  MappedFile file(entry_path(normalized_url));
+  // Entries are written once and renamed into place, the modification time
+  // of the file is when the body was stored.
+  *saved_at = file.modified_at();
+  bool loaded = false;
+  EntryHeader header;
+  if (file.data() != nullptr && file.size() >= sizeof(header)) {
+    std::memcpy(&header, file.data(), sizeof(header));
+    const char *url_start = file.data() + sizeof(header);
+    // Also compare the url, in case two urls ended up with the same hash.
+    // The sizes are checked before being used, in case the file is corrupt:
+    // zlib doesn't expand data more than about 1032 times.
+    loaded = header.magic == kMagic && header.format_version == kFormatVersion &&
+             header.url_size <= file.size() &&
+             header.compressed_size <= file.size() &&
+             file.size() ==
+                 sizeof(header) + header.url_size + header.compressed_size &&
+             header.raw_size <= kMaxRawSize &&
+             header.raw_size <= header.compressed_size * 1032 &&
+             normalized_url.compare(0, std::string::npos, url_start,
+                                    header.url_size) == 0;
+    if (loaded) {
+      body->resize(header.raw_size);
+      uLongf raw_size = header.raw_size;
+      loaded =
+          uncompress(reinterpret_cast<Bytef *>(&(*body)[0]), &raw_size,
+                     reinterpret_cast<const Bytef *>(url_start +
+                                                     header.url_size),
+                     header.compressed_size) == Z_OK &&
+          raw_size == header.raw_size;
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(stats_mutex_);
+  if (!loaded) {
+    body->clear();
+    ++stats_.load_misses;
+    return false;
+  }
+  ++stats_.loads;
+  return true;
+}
+
+bool ResponseStore::Save(const std::string &url, const std::string &body) {
+  const std::string normalized_url = normalize_url(url);
+  std::vector<Bytef> compressed(compressBound(body.size()));
+  uLongf compressed_size = compressed.size();
+  if (compress2(compressed.data(), &compressed_size,
+                reinterpret_cast<const Bytef *>(body.data()), body.size(),
+                Z_DEFAULT_COMPRESSION) != Z_OK) {
+    return false;
+  }
+
+  EntryHeader header = {};
+  header.magic = kMagic;
+  header.format_version = kFormatVersion;
+  header.url_size = normalized_url.size();
+  header.raw_size = body.size();
+  header.compressed_size = compressed_size;
+
+  // Write to a temporary file first and rename it, so that readers never see
+  // a partially written entry.
+  const std::string path = entry_path(normalized_url);
+  static std::atomic<uint64_t> tmp_counter{0};
+  const std::string tmp_path = path + ".tmp" + std::to_string(getpid()) + "_" +
+                               std::to_string(tmp_counter++);
+  {
+    std::ofstream file(tmp_path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+      return false;
+    }
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(normalized_url.data(), normalized_url.size());
+    file.write(reinterpret_cast<const char *>(compressed.data()),
+               compressed_size);
+    if (!file.good()) {
+      std::remove(tmp_path.c_str());
+      return false;
+    }
+  }
+  std::error_code error;
+  std::filesystem::rename(tmp_path, path, error);
+  if (error) {
+    std::remove(tmp_path.c_str());
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(stats_mutex_);
+  ++stats_.saves;
+  stats_.compressed_bytes += sizeof(header) + normalized_url.size() +
+                             compressed_size;
+  stats_.raw_bytes += body.size();
+  return true;
+}
+
+void ResponseStore::SaveAsync(const std::string &url,
+                              std::shared_ptr<const std::string> body) {
+  std::unique_lock<std::mutex> lock(writer_mutex_);
+  writer_done_.wait(lock, [this]() {
+    return pending_saves_.size() < kMaxPendingSaves;
+  });
+  if (!writer_.joinable()) {
+    writer_ = std::thread([this]() { write_pending(); });
+  }
+  pending_saves_.push_back({url, std::move(body)});
+  lock.unlock();
+  writer_wakeup_.notify_one();
+}
+
+void ResponseStore::Flush() {
+  std::unique_lock<std::mutex> lock(writer_mutex_);
+  writer_done_.wait(lock,
+                    [this]() { return pending_saves_.empty() && !writing_; });
+}
+
+void ResponseStore::write_pending() {
+  std::unique_lock<std::mutex> lock(writer_mutex_);
+  while (true) {
+    writer_wakeup_.wait(
+        lock, [this]() { return stopping_ || !pending_saves_.empty(); });
+    if (pending_saves_.empty()) {
+      // Stopping, and every queued save was written.
+      return;
+    }
+    PendingSave save = std::move(pending_saves_.front());
+    pending_saves_.pop_front();
+    writing_ = true;
+    lock.unlock();
+    Save(save.url, *save.body);
+    save.body.reset();
+    lock.lock();
+    writing_ = false;
+    writer_done_.notify_all();
+  }
+}
+
+ResponseStore::Stats ResponseStore::GetStats() {
+  std::lock_guard<std::mutex> lock(stats_mutex_);
+  return stats_;
+}
+
+std::string ResponseStore::normalize_url(const std::string &url) {
+  const auto query_pos = url.find('?');
+  std::string base = url.substr(0, query_pos);
+
+  // Scheme and host are case insensitive, the path isn't.
+  const auto scheme_end = base.find("://");
+  const auto host_end = base.find(
+      '/', scheme_end == std::string::npos ? 0 : scheme_end + 3);
+  std::transform(base.begin(),
+                 host_end == std::string::npos ? base.end()
+                                               : base.begin() + host_end,
+                 base.begin(),
+                 [](unsigned char c) -> char { return std::tolower(c); });
+  if (query_pos == std::string::npos) {
+    return base;
+  }
+
+  std::vector<std::string> parameters;
+  for (const auto &parameter : split(url.substr(query_pos + 1), "&")) {
+    if (!parameter.empty()) {
+      parameters.push_back(parameter);
+    }
+  }
+  if (parameters.empty()) {
+    return base;
+  }
+  std::sort(parameters.begin(), parameters.end());
+  std::string normalized = base + "?";
+  for (const auto &parameter : parameters) {
+    normalized += parameter + "&";
+  }
+  normalized.pop_back();
+  return normalized;
+}
+
+std::string ResponseStore::entry_path(const std::string &normalized_url) {
+  char name[17];
+  std::snprintf(name, sizeof(name), "%016llx",
+                static_cast<unsigned long long>(fnv1a_hash(normalized_url)));
+  return directory_ + "/" + name + ".fbrs";
+}
+} // namespace fantasy_ball
@@ -0,0 +1,105 @@
+#ifndef RESPONSE_STORE_H_
+#define RESPONSE_STORE_H_
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace fantasy_ball {
+
+// On-disk store of endpoint responses. Each response is kept in its own file,
+// named after the hash of the normalized url, and compressed with zlib. Files
+// are memory-mapped when read back. Saves can be handed to a background writer,
+// so that the compression and the file writes stay off the calling thread.
+class ResponseStore {
+public:
+  struct Stats {
+    Stats() = default;
+    uint64_t loads = 0;
+    uint64_t load_misses = 0;
+    uint64_t saves = 0;
+
+    // Bytes written to disk, and the size of the bodies they hold.
+    uint64_t compressed_bytes = 0;
+    uint64_t raw_bytes = 0;
+  };
+
+  explicit ResponseStore(const std::string &directory);
+
+  // Writes the pending saves before returning.
+  ~ResponseStore();
+
+  // Creates the store directory if needed. Returns whether the store can be
+  // used.
+  bool Init();
+
+  // Reads the stored body for the url. Returns false if there's none.
+  bool Load(const std::string &url, std::string *body);
+
+  // Same as above, also returns when the body was stored.
+  bool Load(const std::string &url, std::string *body,
+            std::chrono::system_clock::time_point *saved_at);
+
+  // Stores the body for the url, replacing any previous one. Returns whether
+  // the body was written.
+  bool Save(const std::string &url, const std::string &body);
+
+  // Queues the body to be stored for the url by the background writer, which
+  // is started on the first call. Only blocks while kMaxPendingSaves bodies
+  // are already waiting to be written.
+  void SaveAsync(const std::string &url,
+                 std::shared_ptr<const std::string> body);
+
+  // Blocks until the saves queued so far are written.
+  void Flush();
+
+  Stats GetStats();
+
+  // Returns the url with a lowercase scheme and host, and its query parameters
+  // sorted, so that equivalent urls share the same entry.
+  static std::string normalize_url(const std::string &url);
+
+private:
+  struct PendingSave {
+    std::string url;
+    std::shared_ptr<const std::string> body;
+  };
+
+  const std::string directory_;
+  std::mutex stats_mutex_;
+  Stats stats_;
+
+  // Saves waiting for the background writer. The writer signals
+  // writer_done_ after each save.
+  std::mutex writer_mutex_;
+  std::condition_variable writer_wakeup_;
+  std::condition_variable writer_done_;
+  std::deque<PendingSave> pending_saves_;
+  bool writing_ = false;
+  bool stopping_ = false;
+  std::thread writer_;
+  static const size_t kMaxPendingSaves;
+
+  // Writes the queued saves until the store is destroyed.
+  void write_pending();
+
+  // Returns the path of the file holding the entry for the normalized url.
+  std::string entry_path(const std::string &normalized_url);
+
+  // Identifies the files written by this class, followed by the format
+  // version.
+  static const uint32_t kMagic;
+  static const uint32_t kFormatVersion;
+
+  // Bounds the body of an entry, larger sizes mean the file is corrupt.
+  static const uint64_t kMaxRawSize;
+};
+
+} // namespace fantasy_ball
+
+#endif // RESPONSE_STORE_H_
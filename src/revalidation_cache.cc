@@ -0,0 +1,86 @@
+#include "revalidation_cache.h"
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace fantasy_ball {
+
+RevalidationCache::RevalidationCache(size_t max_entries)
+    : RevalidationCache(max_entries, SIZE_MAX) {}
+
+RevalidationCache::RevalidationCache(size_t max_entries, size_t max_bytes)
+    : max_entries_(max_entries == 0 ? 1 : max_entries), max_bytes_(max_bytes) {
+}
+
+std::shared_ptr<const RevalidationCache::Entry>
+RevalidationCache::Find(const std::string &url) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = entries_.find(url);
+  if (it == entries_.end()) {
+    return nullptr;
+  }
+  lru_.splice(lru_.begin(), lru_, it->second.lru_position);
+  return it->second.entry;
+}
+
+uint64_t RevalidationCache::Store(const std::string &url,
+                                  const std::string &etag,
+                                  const std::string &last_modified,
+                                  std::shared_ptr<const std::string> body) {
+  if (body->size() > max_bytes_) {
+    // The previous body is no longer the latest one.
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(url);
+    if (it != entries_.end()) {
+      erase(it);
+    }
+    return 0;
+  }
+  auto entry = std::make_shared<Entry>();
+  entry->etag = etag;
+  entry->last_modified = last_modified;
+  entry->body = std::move(body);
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  entry->version = next_version_++;
+  const uint64_t version = entry->version;
+  ++stats_.updated;
+  bytes_ += entry->body->size();
+  auto it = entries_.find(url);
+  if (it != entries_.end()) {
+    bytes_ -= it->second.entry->body->size();
+    it->second.entry = std::move(entry);
+    lru_.splice(lru_.begin(), lru_, it->second.lru_position);
+  } else {
+    lru_.push_front(url);
+    entries_[url] = {std::move(entry), lru_.begin()};
+  }
+  // The new body is at the front, and fits the budget on its own.
+  while (entries_.size() > max_entries_ || bytes_ > max_bytes_) {
+    erase(entries_.find(lru_.back()));
+  }
+  return version;
+}
+
+void RevalidationCache::erase(
+    std::unordered_map<std::string, Slot>::iterator it) {
+  bytes_ -= it->second.entry->body->size();
+  lru_.erase(it->second.lru_position);
+  entries_.erase(it);
+}
+
+void RevalidationCache::RecordNotModified() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  ++stats_.not_modified;
+}
+
+RevalidationCache::Stats RevalidationCache::GetStats() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Stats stats = stats_;
+  stats.entries = entries_.size();
+  stats.bytes = bytes_;
+  return stats;
+}
+} // namespace fantasy_ball
@@ -0,0 +1,145 @@
+#ifndef REVALIDATION_CACHE_H_
+#define REVALIDATION_CACHE_H_
+
+#include <any>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace fantasy_ball {
+
+// Keeps the latest body of each fetched url along with its HTTP validators
+// (ETag and Last-Modified), so that the next call to the same url can be a
+// conditional request. When the endpoint answers 304 Not Modified, the cached
+// body is handed back, along with the object a fetcher parsed from it, if any.
+// Bodies without validators are kept too, as the last good body of their url.
+class RevalidationCache {
+public:
+  struct Entry {
+    Entry() = default;
+
+    // Both empty when the endpoint sent no validators, the next call to the
+    // url is then a plain request.
+    std::string etag;
+    std::string last_modified;
+
+    // Shared with the responses, never null.
+    std::shared_ptr<const std::string> body;
+
+    // Incremented every time the body of the url changes. Used to make sure a
+    // parsed object matches the body it was parsed from.
+    uint64_t version = 0;
+
+    // Object parsed from the body by a fetcher, if any.
+    std::any parsed;
+
+    bool has_validators() const {
+      return !etag.empty() || !last_modified.empty();
+    }
+  };
+
+  struct Stats {
+    Stats() = default;
+
+    // Conditional requests answered with 304 Not Modified.
+    uint64_t not_modified = 0;
+
+    // Responses that replaced (or added) the body for a url.
+    uint64_t updated = 0;
+
+    // Hand backs of a parsed object, that skipped parsing the body again.
+    uint64_t parsed_hits = 0;
+
+    size_t entries = 0;
+
+    // Size of the cached bodies.
+    size_t bytes = 0;
+  };
+
+  // The least recently used urls are dropped once more than max_entries are
+  // cached.
+  explicit RevalidationCache(size_t max_entries);
+
+  // Same as above, also dropping them once the bodies take more than
+  // max_bytes.
+  RevalidationCache(size_t max_entries, size_t max_bytes);
+  ~RevalidationCache() = default;
+
+  // Returns the entry for the url, or null when the url isn't cached. The
+  // entry is shared, so it remains valid even if the url gets updated.
+  std::shared_ptr<const Entry> Find(const std::string &url);
+
+  // Stores a new body with its validators for the url, which may be empty.
+  // Returns the version of the stored body, or zero if the body alone is
+  // larger than max_bytes and isn't cached.
+  uint64_t Store(const std::string &url, const std::string &etag,
+                 const std::string &last_modified,
+                 std::shared_ptr<const std::string> body);
+
+  // Records that the endpoint confirmed a cached body.
+  void RecordNotModified();
+
+  // Attaches the object parsed from the body with the given version.
+  // NOTE: Ignored if the body was updated since then.
+  template <typename T>
+  void StoreParsed(const std::string &url, uint64_t version,
+                   std::shared_ptr<const T> parsed) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(url);
+    if (it == entries_.end() || it->second.entry->version != version) {
+      return;
+    }
+    // Entries are shared with readers, so we swap in an updated copy.
+    auto entry = std::make_shared<Entry>(*it->second.entry);
+    entry->parsed = std::move(parsed);
+    it->second.entry = std::move(entry);
+  }
+
+  // Returns the object parsed from the body with the given version, or null if
+  // there's none (or it's of a different type).
+  template <typename T>
+  std::shared_ptr<const T> GetParsed(const std::string &url,
+                                     uint64_t version) {
+    auto entry = Find(url);
+    if (entry == nullptr || entry->version != version) {
+      return nullptr;
+    }
+    const auto *parsed = std::any_cast<std::shared_ptr<const T>>(&entry->parsed);
+    if (parsed == nullptr) {
+      return nullptr;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++stats_.parsed_hits;
+    return *parsed;
+  }
+
+  Stats GetStats();
+
+private:
+  struct Slot {
+    std::shared_ptr<const Entry> entry;
+    std::list<std::string>::iterator lru_position;
+  };
+
+  const size_t max_entries_;
+  const size_t max_bytes_;
+  std::mutex mutex_;
+  std::unordered_map<std::string, Slot> entries_;
+
+  // Most recently used urls are at the front.
+  std::list<std::string> lru_;
+  uint64_t next_version_ = 1;
+  size_t bytes_ = 0;
+  Stats stats_;
+
+  // Drops the entry of the url.
+  // NOTE: The mutex should be held.
+  void erase(std::unordered_map<std::string, Slot>::iterator it);
+};
+
+} // namespace fantasy_ball
+
+#endif // REVALIDATION_CACHE_H_
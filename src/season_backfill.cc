@@ -0,0 +1,355 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include "curl_fetch.h"
+#include "fetch_scheduler.h"
+#include "player_fetcher.h"
+#include "player_log_columns.h"
+#include "team_fetcher.h"
+#include "util.h"
+
+// Fetches the games and the daily player logs of every date of a season range,
+// e.g. to rebuild the history after a deploy:
+//   season_backfill --season_start=2021-2022-regular --from=20211019
+//                   --to=20220410
+// The responses are recorded in the on-disk response store, so that the
+// servers started with --store_mode=read_through (or replay) serve them
+// without calling the endpoints. Dates are fetched concurrently under the
+// endpoint quota, and parsed in parallel by the worker threads. The logs of
+// the season are also kept in a compact column store, whose size is reported
+// at the end of the run.
+
+// Default quota for each MySportsFeed endpoint family, same as the servers.
+static const double kDefaultRequestsPerSecond = 2;
+static const double kDefaultBurst = 4;
+
+// Configuration read from the command line flags:
+//   --season_start=<season of the dates, e.g. 2021-2022-regular>
+//   --from=<first date, e.g. 20211019>
+//   --to=<last date, included>
+//   --version=<endpoint version>
+//   --workers=<dates fetched and parsed at once>
+//   --checkpoint_file=<file listing the completed dates, to resume a run>
+//   --store_mode=<record|read_through>
+//   --store_dir=<directory of the on-disk response store>
+//   --requests_per_second=<quota for each endpoint family, 0 for no limit>
+//   --burst=<requests allowed at once before the quota is enforced>
+//   --msf_base_url=<base url of the endpoints, e.g. http://localhost:8089 for
+//                   the msf_stub_server>
+struct BackfillConfig {
+  BackfillConfig() = default;
+  std::string season_start;
+  std::string from_date;
+  std::string to_date;
+  std::string version = "v2.1";
+  int workers = 8;
+  std::string checkpoint_file = "season_backfill.checkpoint";
+  fantasy_ball::CurlFetch::StoreMode store_mode =
+      fantasy_ball::CurlFetch::StoreMode::kRecord;
+  std::string store_directory = "cache/";
+  double requests_per_second = kDefaultRequestsPerSecond;
+  double burst = kDefaultBurst;
+};
+
+BackfillConfig config_from_flags(int argc, char *argv[]) {
+  using StoreMode = fantasy_ball::CurlFetch::StoreMode;
+  BackfillConfig config = {};
+  for (int i = 1; i < argc; ++i) {
+    const auto flag = fantasy_ball::split(argv[i], "=");
+    if (flag.size() != 2) {
+      continue;
+    }
+    if (flag[0] == "--season_start") {
+      config.season_start = flag[1];
+    } else if (flag[0] == "--from") {
+      config.from_date = flag[1];
+    } else if (flag[0] == "--to") {
+      config.to_date = flag[1];
+    } else if (flag[0] == "--version") {
+      config.version = flag[1];
+    } else if (flag[0] == "--workers") {
+      config.workers = std::max(1, std::stoi(flag[1]));
+    } else if (flag[0] == "--checkpoint_file") {
+      config.checkpoint_file = flag[1];
+    } else if (flag[0] == "--store_mode") {
+      config.store_mode = (flag[1] == "read_through" ? StoreMode::kReadThrough
+                                                     : StoreMode::kRecord);
+    } else if (flag[0] == "--store_dir") {
+      config.store_directory = flag[1];
+    } else if (flag[0] == "--requests_per_second") {
+      config.requests_per_second = std::stod(flag[1]);
+    } else if (flag[0] == "--burst") {
+      config.burst = std::stod(flag[1]);
+    } else if (flag[0] == "--msf_base_url") {
+      fantasy_ball::endpoint::set_msf_base_url(flag[1]);
+    }
+  }
+  return config;
+}
+
+// Returns every date from the first to the last one (included), in the
+// endpoint format (e.g. 20211019). Returns an empty list if either date is
+// malformed.
+std::vector<std::string> dates_between(const std::string &from_date,
+                                       const std::string &to_date) {
+  std::vector<std::string> dates;
+  std::tm from = {};
+  std::tm to = {};
+  std::istringstream from_stream(from_date);
+  std::istringstream to_stream(to_date);
+  from_stream >> std::get_time(&from, "%Y%m%d");
+  to_stream >> std::get_time(&to, "%Y%m%d");
+  if (from_date.size() != 8 || to_date.size() != 8 || from_stream.fail() ||
+      to_stream.fail()) {
+    return dates;
+  }
+  // NOTE: The dates are handled as UTC so that daylight saving changes don't
+  // skip or repeat a day.
+  const std::time_t last = timegm(&to);
+  for (std::time_t day = timegm(&from); day <= last; day += 24 * 60 * 60) {
+    std::tm date = {};
+    gmtime_r(&day, &date);
+    char buffer[9];
+    std::strftime(buffer, sizeof(buffer), "%Y%m%d", &date);
+    dates.push_back(buffer);
+  }
+  return dates;
+}
+
+// Dates completed by the previous runs, one per line. A date is appended once
+// its player logs were fetched, so an interrupted run resumes from the dates
+// that are missing.
+class Checkpoint {
+public:
+  explicit Checkpoint(const std::string &path) : path_(path) {}
+
+  // Reads the completed dates. Returns false if the file can't be opened for
+  // appending.
+  bool Init() {
+    std::ifstream input(path_);
+    std::string date;
+    while (std::getline(input, date)) {
+      fantasy_ball::trim_new_line(&date);
+      if (!date.empty()) {
+        completed_.insert(date);
+      }
+    }
+    output_.open(path_, std::ios::app);
+    return output_.is_open();
+  }
+
+  bool IsCompleted(const std::string &date) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return completed_.count(date) > 0;
+  }
+
+  void Complete(const std::string &date) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    completed_.insert(date);
+    // Flushed right away, the run may be stopped at any time.
+    output_ << date << std::endl;
+  }
+
+private:
+  std::string path_;
+  std::mutex mutex_;
+  std::unordered_set<std::string> completed_;
+  std::ofstream output_;
+};
+
+class SeasonBackfill {
+public:
+  SeasonBackfill(const BackfillConfig &config,
+                 fantasy_ball::CurlFetch *curl_fetch,
+                 fantasy_ball::PlayerFetcher *player_fetcher,
+                 Checkpoint *checkpoint)
+      : config_(config), curl_fetch_(curl_fetch),
+        player_fetcher_(player_fetcher), checkpoint_(checkpoint) {}
+
+  // Fetches the dates that aren't completed yet. Returns false if any of them
+  // failed, in which case running again retries them.
+  bool Run(const std::vector<std::string> &dates) {
+    for (const auto &date : dates) {
+      if (!checkpoint_->IsCompleted(date)) {
+        pending_dates_.push_back(date);
+      }
+    }
+    std::cout << "Backfilling " << pending_dates_.size() << " of "
+              << dates.size() << " dates with " << config_.workers
+              << " workers." << std::endl;
+    start_ = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (int i = 0; i < config_.workers; ++i) {
+      workers.emplace_back([this]() { work(); });
+    }
+    for (auto &worker : workers) {
+      worker.join();
+    }
+    report_summary();
+    return failed_dates_ == 0;
+  }
+
+private:
+  BackfillConfig config_;
+
+  // NOTE: This class doesn't have ownership of these objects.
+  fantasy_ball::CurlFetch *curl_fetch_;
+  fantasy_ball::PlayerFetcher *player_fetcher_;
+  Checkpoint *checkpoint_;
+
+  std::vector<std::string> pending_dates_;
+  std::atomic<size_t> next_date_{0};
+  std::atomic<size_t> done_dates_{0};
+  std::atomic<size_t> failed_dates_{0};
+  std::atomic<size_t> player_logs_{0};
+  std::chrono::steady_clock::time_point start_;
+  std::mutex output_mutex_;
+
+  // Logs of every completed date, guarded by the logs mutex.
+  fantasy_ball::PlayerLogColumns season_logs_;
+  std::mutex logs_mutex_;
+
+  // Takes the next pending date until there are none left. The endpoint calls
+  // of the workers overlap, and each worker parses its own responses.
+  void work() {
+    for (size_t i = next_date_++; i < pending_dates_.size();
+         i = next_date_++) {
+      const auto &date = pending_dates_[i];
+      fantasy_ball::endpoint::Options options = {};
+      options.date = date;
+      options.season_start = config_.season_start;
+      options.version = config_.version;
+      options.strict_search = true;
+      // NOTE: The games of the date are fetched along with the player logs,
+      // the date is only completed when both calls succeeded, so that both
+      // responses are in the store.
+      std::vector<fantasy_ball::PlayerFetcher::DailyPlayerLog> daily_logs;
+      const bool fetched =
+          player_fetcher_->GetAllPlayerLogs(&options, &daily_logs);
+      ++done_dates_;
+      if (fetched) {
+        player_logs_ += daily_logs.size();
+        keep_logs(daily_logs);
+        // The responses are written in the background, the date is only
+        // completed once they're on disk.
+        if (curl_fetch_->response_store() != nullptr) {
+          curl_fetch_->response_store()->Flush();
+        }
+        checkpoint_->Complete(date);
+      } else {
+        ++failed_dates_;
+      }
+      report_progress(date, fetched, daily_logs.size());
+    }
+  }
+
+  void keep_logs(
+      const std::vector<fantasy_ball::PlayerFetcher::DailyPlayerLog> &logs) {
+    std::lock_guard<std::mutex> lock(logs_mutex_);
+    for (const auto &log : logs) {
+      season_logs_.Append(log);
+    }
+  }
+
+  void report_progress(const std::string &date, bool fetched,
+                       size_t log_count) {
+    const double seconds = elapsed_seconds();
+    const size_t done = done_dates_;
+    std::lock_guard<std::mutex> lock(output_mutex_);
+    std::cout << "[" << done << "/" << pending_dates_.size() << "] " << date
+              << ": "
+              << (fetched ? std::to_string(log_count) + " player logs"
+                          : std::string("failed"))
+              << " (" << std::fixed << std::setprecision(2)
+              << done / seconds << " dates/s, "
+              << wire_bytes() / seconds / (1024 * 1024) << " MB/s)"
+              << std::endl;
+  }
+
+  void report_summary() {
+    const double seconds = elapsed_seconds();
+    std::cout << "Backfilled " << done_dates_ - failed_dates_ << " dates ("
+              << player_logs_ << " player logs) in " << std::fixed
+              << std::setprecision(1) << seconds << "s, "
+              << failed_dates_ << " failed." << std::endl;
+    {
+      std::lock_guard<std::mutex> lock(logs_mutex_);
+      std::cout << "Kept " << season_logs_.size() << " player logs in "
+                << season_logs_.memory_bytes() / 1024 << " KB." << std::endl;
+    }
+    for (const auto &endpoint : curl_fetch_->GetEndpointBytes()) {
+      std::cout << endpoint.first << ": " << endpoint.second.transfers
+                << " transfers, " << endpoint.second.wire_bytes
+                << " wire bytes, " << endpoint.second.decoded_bytes
+                << " decoded bytes" << std::endl;
+    }
+  }
+
+  double elapsed_seconds() const {
+    const std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start_;
+    // Avoids dividing by zero for the first reports.
+    return std::max(elapsed.count(), 1e-3);
+  }
+
+  uint64_t wire_bytes() const {
+    uint64_t bytes = 0;
+    for (const auto &endpoint : curl_fetch_->GetEndpointBytes()) {
+      bytes += endpoint.second.wire_bytes;
+    }
+    return bytes;
+  }
+};
+
+int main(int argc, char *argv[]) {
+  const BackfillConfig config = config_from_flags(argc, argv);
+  const auto dates = dates_between(config.from_date, config.to_date);
+  if (config.season_start.empty() || dates.empty()) {
+    std::cout << "Usage: season_backfill --season_start=<season> "
+                 "--from=<yyyymmdd> --to=<yyyymmdd>"
+              << std::endl;
+    return 1;
+  }
+  Checkpoint checkpoint(config.checkpoint_file);
+  if (!checkpoint.Init()) {
+    std::cout << "Couldn't open the checkpoint file." << std::endl;
+    return 1;
+  }
+
+  // Create the required fetchers.
+  std::unique_ptr<fantasy_ball::FetchScheduler> scheduler;
+  if (config.requests_per_second > 0) {
+    scheduler = std::make_unique<fantasy_ball::FetchScheduler>(
+        fantasy_ball::FetchScheduler::Limit(config.requests_per_second,
+                                            config.burst));
+  }
+  fantasy_ball::CurlFetch::Config fetch_config = {};
+  fetch_config.pool_size = config.workers;
+  fetch_config.store_mode = config.store_mode;
+  fetch_config.store_directory = config.store_directory;
+  fetch_config.scheduler = scheduler.get();
+  // Each date is fetched once, the bodies don't need to be kept in memory.
+  fetch_config.revalidation_entries = 0;
+  fantasy_ball::CurlFetch curl_fetch;
+  if (!curl_fetch.Init(fetch_config)) {
+    std::cout << "Couldn't open the response store." << std::endl;
+    return 1;
+  }
+  fantasy_ball::TeamFetcher team_fetcher(&curl_fetch);
+  fantasy_ball::PlayerFetcher player_fetcher(&curl_fetch, &team_fetcher);
+
+  SeasonBackfill backfill(config, &curl_fetch, &player_fetcher, &checkpoint);
+  return backfill.Run(dates) ? 0 : 1;
+}
@@ -0,0 +1,141 @@
+#ifndef SINGLE_FLIGHT_H_
+#define SINGLE_FLIGHT_H_
+
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+namespace fantasy_ball {
+
+// Coalesces concurrent calls for the same key: the first caller (the leader)
+// does the work, and the callers that arrive while it is in flight wait for it
+// and share its result instead of repeating the work.
+template <typename Key, typename Value, typename Hash = std::hash<Key>>
+class SingleFlight {
+public:
+  struct Stats {
+    Stats() = default;
+
+    // Calls that did the work.
+    uint64_t leaders = 0;
+
+    // Calls that shared the result of an in flight call.
+    uint64_t coalesced = 0;
+  };
+
+  // Handle on an in flight call. Only the leader gets the promise, and must
+  // hand the result to Finish.
+  struct Call {
+    std::shared_future<Value> result;
+    std::shared_ptr<std::promise<Value>> promise;
+
+    bool is_leader() const { return promise != nullptr; }
+  };
+
+  SingleFlight() = default;
+  ~SingleFlight() = default;
+
+  // Joins the in flight call for the key, or starts a new one.
+  Call Begin(const Key &key) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = calls_.find(key);
+    if (it != calls_.end()) {
+      ++stats_.coalesced;
+      ++it->second.followers;
+      return {it->second.result, nullptr};
+    }
+    ++stats_.leaders;
+    auto promise = std::make_shared<std::promise<Value>>();
+    std::shared_future<Value> result = promise->get_future().share();
+    calls_.emplace(key, Flight{result, 0});
+    return {result, promise};
+  }
+
+  // Completes the call started by the leader, and hands the value back to the
+  // leader. The value is only copied when other callers are waiting for it.
+  // Callers arriving after this start a new call.
+  Value Finish(const Key &key, const Call &call, Value value) {
+    size_t followers = 0;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      auto it = calls_.find(key);
+      if (it != calls_.end()) {
+        followers = it->second.followers;
+        calls_.erase(it);
+      }
+    }
+    if (followers > 0) {
+      call.promise->set_value(value);
+    }
+    return value;
+  }
+
+  // Completes the call started by the leader with an error, e.g. when its work
+  // threw. The waiting callers get the error, and callers arriving after this
+  // start a new call.
+  void Fail(const Key &key, const Call &call, std::exception_ptr error) {
+    size_t followers = 0;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      auto it = calls_.find(key);
+      if (it != calls_.end()) {
+        followers = it->second.followers;
+        calls_.erase(it);
+      }
+    }
+    if (followers > 0) {
+      call.promise->set_exception(error);
+    }
+  }
+
+  // Returns the result of fn for the key. Concurrent callers with the same key
+  // wait for a single call of fn and get a copy of its result. If fn throws,
+  // the waiting callers get the same exception.
+  Value Do(const Key &key, const std::function<Value()> &fn) {
+    auto call = Begin(key);
+    if (!call.is_leader()) {
+      return call.result.get();
+    }
+    auto value = [&]() {
+      try {
+        return fn();
+      } catch (...) {
+        Fail(key, call, std::current_exception());
+        throw;
+      }
+    }();
+    return Finish(key, call, std::move(value));
+  }
+
+  // Returns true when a call for the key is in flight.
+  bool InFlight(const Key &key) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return calls_.count(key) > 0;
+  }
+
+  Stats GetStats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+  }
+
+private:
+  struct Flight {
+    std::shared_future<Value> result;
+
+    // Callers waiting for the result, besides the leader.
+    size_t followers = 0;
+  };
+
+  std::mutex mutex_;
+  std::unordered_map<Key, Flight, Hash> calls_;
+  Stats stats_;
+};
+
+} // namespace fantasy_ball
+
+#endif // SINGLE_FLIGHT_H_
@@ -0,0 +1,68 @@
+#include "symbol_table.h"
+
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+
+namespace fantasy_ball {
+
+SymbolTable &SymbolTable::Global() {
+  // NOTE: Never destroyed, Symbols may still be read by static objects at
+  // exit.
+  static SymbolTable *table = new SymbolTable();
+  return *table;
+}
+
+const std::string *SymbolTable::Intern(std::string_view text) {
+  const std::string key(text);
+  {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    const auto it = symbols_.find(key);
+    if (it != symbols_.end()) {
+      return &(*it);
+    }
+  }
+  std::unique_lock<std::shared_mutex> lock(mutex_);
+  return &(*symbols_.insert(key).first);
+}
+
+const std::string *SymbolTable::Find(std::string_view text) {
+  const std::string key(text);
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+  const auto it = symbols_.find(key);
+  return (it == symbols_.end() ? nullptr : &(*it));
+}
+
+size_t SymbolTable::size() {
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+  return symbols_.size();
+}
+
+Symbol::Symbol() {
+  // Default constructed for every new log, the empty string is only looked up
+  // once.
+  static const std::string *empty = SymbolTable::Global().Intern("");
+  text_ = empty;
+}
+
+Symbol::Symbol(const std::string &text)
+    : text_(SymbolTable::Global().Intern(text)) {}
+
+Symbol::Symbol(const char *text)
+    : text_(SymbolTable::Global().Intern(text)) {}
+
+bool Symbol::Find(const std::string &text, Symbol *symbol) {
+  const std::string *stored = SymbolTable::Global().Find(text);
+  if (stored == nullptr) {
+    return false;
+  }
+  symbol->text_ = stored;
+  return true;
+}
+
+std::ostream &operator<<(std::ostream &stream, const Symbol &symbol) {
+  return stream << symbol.str();
+}
+
+} // namespace fantasy_ball
@@ -0,0 +1,89 @@
+#ifndef SYMBOL_TABLE_H_
+#define SYMBOL_TABLE_H_
+
+#include <cstddef>
+#include <functional>
+#include <ostream>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+
+namespace fantasy_ball {
+
+// Process wide set of the strings that are repeated across the player logs,
+// e.g. names, team abbreviations and positions. Each distinct string is
+// stored once and keeps the same address for the lifetime of the process.
+// NOTE: Thread safe. Strings are never removed, so only the values seen in
+// the responses (a few thousand names and codes) should be interned. Strings
+// supplied by clients, e.g. the names of a player search, should be kept as
+// std::string or looked up with Symbol::Find.
+class SymbolTable {
+public:
+  // Returns the table used by every Symbol.
+  static SymbolTable &Global();
+
+  SymbolTable() = default;
+  SymbolTable(const SymbolTable &) = delete;
+  SymbolTable &operator=(const SymbolTable &) = delete;
+
+  // Returns the stored copy of the text, adding it if it's new.
+  const std::string *Intern(std::string_view text);
+
+  // Returns the stored copy of the text, or nullptr if it isn't stored.
+  const std::string *Find(std::string_view text);
+
+  size_t size();
+
+private:
+  // NOTE: Lookups of strings that are already stored, the common case, only
+  // take the lock as shared.
+  std::shared_mutex mutex_;
+
+  // Node based, so that the stored strings don't move on rehash.
+  std::unordered_set<std::string> symbols_;
+};
+
+// String interned in the global SymbolTable. Copies and comparisons are
+// pointer sized, while reading it gives the usual const std::string.
+class Symbol {
+public:
+  // The empty string.
+  Symbol();
+
+  Symbol(const std::string &text);
+  Symbol(const char *text);
+
+  // Gets the symbol of the text without interning it. Returns false if the
+  // text isn't interned yet, e.g. to look up client supplied strings.
+  static bool Find(const std::string &text, Symbol *symbol);
+
+  const std::string &str() const { return *text_; }
+  operator const std::string &() const { return *text_; }
+
+  bool empty() const { return text_->empty(); }
+
+  bool operator==(const Symbol &other) const { return text_ == other.text_; }
+  bool operator!=(const Symbol &other) const { return text_ != other.text_; }
+
+  // Identifies the symbol, e.g. to hash it, for the lifetime of the process.
+  const void *id() const { return text_; }
+
+private:
+  // NOTE: Owned by the global SymbolTable.
+  const std::string *text_;
+};
+
+std::ostream &operator<<(std::ostream &stream, const Symbol &symbol);
+
+} // namespace fantasy_ball
+
+namespace std {
+template <> struct hash<fantasy_ball::Symbol> {
+  size_t operator()(const fantasy_ball::Symbol &symbol) const {
+    return hash<const void *>()(symbol.id());
+  }
+};
+} // namespace std
+
+#endif // SYMBOL_TABLE_H_
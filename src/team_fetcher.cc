@@ -1,40 +1,181 @@
 #include "team_fetcher.h"
 
-#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <utility>
 
 #include "curl_fetch.h"
+#include "feed_schema.h"
+#include "json_value.h"
 #include "player_fetcher.h"
 
 namespace fantasy_ball {
 const std::string TeamFetcher::kBaseUrl =
-    "https://api.mysportsfeeds.com/<version>/pull/nba/<season-start>/date/"
-    "<date>/games.json";
+    "<base>/<version>/pull/nba/<season-start>/date/<date>/games.json";
 // e.g.
 // https://api.mysportsfeeds.com/v2.1/pull/nba/2020-2021-regular/date/20210319/games.json
+const std::chrono::milliseconds TeamFetcher::kDefaultLiveTtl =
+    std::chrono::seconds(30);
+const size_t TeamFetcher::kGamesCacheBytes = 4 << 20;
 
-TeamFetcher::TeamFetcher(CurlFetch *curl_fetch) : curl_fetch_(curl_fetch) {}
+TeamFetcher::GameMatchup
+TeamFetcher::GameMatchup::deserialize_json(const JsonValue &json_content) {
+  GameMatchup matchup = {};
+  matchup.event_id = -1;
+  if (!json_content.contains("schedule") || !json_content.contains("score")) {
+    return matchup;
+  }
+  feed_schema::decode_fields(json_content, feed_schema::kGameMatchupFields,
+                             &matchup);
+  return matchup;
+}
+
+TeamFetcher::GameStatus TeamFetcher::GameMatchup::status() const {
+  static const Symbol kCompleted("COMPLETED");
+  static const Symbol kCompletedPendingReview("COMPLETED_PENDING_REVIEW");
+  static const Symbol kLive("LIVE");
+  static const Symbol kUnplayed("UNPLAYED");
+  if (played_status == kCompleted) {
+    return GameStatus::kFinal;
+  }
+  // The stats of a game pending review may still be corrected, it's refreshed
+  // like a live game until it's completed.
+  if (played_status == kLive || played_status == kCompletedPendingReview) {
+    return GameStatus::kLive;
+  }
+  if (played_status == kUnplayed) {
+    return GameStatus::kScheduled;
+  }
+  return GameStatus::kUnknown;
+}
+
+TeamFetcher::TeamFetcher(CurlFetch *curl_fetch)
+    : curl_fetch_(curl_fetch), live_ttl_(kDefaultLiveTtl),
+      cached_games_(kGamesCacheBytes) {}
 
 TeamFetcher::~TeamFetcher() {}
 
+TeamFetcher::Clock::time_point
+TeamFetcher::CacheExpiry(GameStatus status,
+                         std::chrono::milliseconds live_ttl) {
+  switch (status) {
+  case GameStatus::kFinal:
+    return Clock::time_point::max();
+  case GameStatus::kScheduled:
+    return Clock::now();
+  default:
+    return Clock::now() + live_ttl;
+  }
+}
+
+void TeamFetcher::SetLiveTtl(std::chrono::milliseconds live_ttl) {
+  live_ttl_ = live_ttl;
+}
+
 std::vector<TeamFetcher::GameMatchup>
 TeamFetcher::GetGameReferences(endpoint::Options *options) {
-  using json = nlohmann::json;
-  std::vector<GameMatchup> matchups;
   const std::string endpoint_url = construct_endpoint_url(options);
-  std::string content = curl_fetch_->GetContent(endpoint_url);
-  if (curl_fetch_->curl_ret()) {
+  std::vector<GameMatchup> matchups;
+  if (find_cached_games(endpoint_url, &matchups)) {
     return matchups;
   }
-  if (!json::accept(content)) {
-    return matchups;
+  auto fetch = [this, &endpoint_url]() {
+    auto response = curl_fetch_->GetResponse(endpoint_url);
+    if (response.curl_code) {
+      return std::vector<GameMatchup>();
+    }
+    return read_game_references(endpoint_url, response);
+  };
+  if (curl_fetch_->CanServeStale(endpoint_url)) {
+    // Don't wait on the call in flight, the last good games are served.
+    return fetch();
   }
-  json data = json::parse(content);
-  if (!data.contains("games")) {
+  return in_flight_.Do(endpoint_url, fetch);
+}
+
+std::future<std::vector<TeamFetcher::GameMatchup>>
+TeamFetcher::GetGameReferencesAsync(endpoint::Options *options) {
+  return GetGameReferencesAsync(options, nullptr);
+}
+
+std::future<std::vector<TeamFetcher::GameMatchup>>
+TeamFetcher::GetGameReferencesAsync(endpoint::Options *options,
+                                    CURLcode *curl_code) {
+  const std::string endpoint_url = construct_endpoint_url(options);
+  std::vector<GameMatchup> matchups;
+  if (find_cached_games(endpoint_url, &matchups)) {
+    if (curl_code != nullptr) {
+      *curl_code = CURLE_OK;
+    }
+    return std::async(std::launch::deferred,
+                      [matchups = std::move(matchups)]() { return matchups; });
+  }
+  auto response = curl_fetch_->GetContentAsync(endpoint_url);
+  return std::async(std::launch::deferred,
+                    [this, endpoint_url, curl_code,
+                     response = std::move(response)]() mutable {
+                      auto content = response.get();
+                      if (curl_code != nullptr) {
+                        *curl_code = (content.curl_code == CURLE_OK &&
+                                              content.http_code >= 400
+                                          ? CURLE_HTTP_RETURNED_ERROR
+                                          : content.curl_code);
+                      }
+                      if (content.curl_code) {
+                        return std::vector<GameMatchup>();
+                      }
+                      return read_game_references(endpoint_url, content);
+                    });
+}
+
+std::vector<TeamFetcher::GameMatchup>
+TeamFetcher::read_game_references(const std::string &url,
+                                  const CurlFetch::Response &response) {
+  const auto start = CurlFetch::Clock::now();
+  auto *cache = curl_fetch_->revalidation_cache();
+  const bool cacheable = (cache != nullptr && response.cache_version != 0);
+  std::shared_ptr<const std::vector<GameMatchup>> matchups;
+  if (cacheable) {
+    // The body didn't change since we last parsed it, reuse those matchups.
+    matchups =
+        cache->GetParsed<std::vector<GameMatchup>>(url, response.cache_version);
+  }
+  if (matchups == nullptr) {
+    matchups = std::make_shared<const std::vector<GameMatchup>>(
+        parse_game_references(*response.body));
+    if (cacheable) {
+      cache->StoreParsed(url, response.cache_version, matchups);
+    }
+  }
+  curl_fetch_->RecordTiming(
+      url, CurlFetch::Phase::kParse,
+      std::chrono::duration_cast<std::chrono::microseconds>(
+          CurlFetch::Clock::now() - start)
+          .count());
+  if (!response.stale) {
+    cache_games(url, *matchups);
+    return *matchups;
+  }
+  auto stale_matchups = *matchups;
+  for (auto &matchup : stale_matchups) {
+    matchup.stale = true;
+  }
+  return stale_matchups;
+}
+
+std::vector<TeamFetcher::GameMatchup>
+TeamFetcher::parse_game_references(const std::string &content) {
+  std::vector<GameMatchup> matchups;
+  // Invalid json content is discarded instead of throwing.
+  JsonDocument document;
+  if (!document.Parse(content) || !document.root().contains("games")) {
     return matchups;
   }
-  const auto &games = data["games"];
-  for (const auto &game : games) {
+  for (const auto &game : document.root()["games"].items()) {
     const auto &game_matchup = GameMatchup::deserialize_json(game);
     if (game_matchup.event_id == -1) {
       continue;
@@ -44,13 +185,50 @@ TeamFetcher::GetGameReferences(endpoint::Options *options) {
   return matchups;
 }
 
+bool TeamFetcher::find_cached_games(const std::string &url,
+                                    std::vector<GameMatchup> *matchups) {
+  const auto now = Clock::now();
+  CachedGames cached;
+  if (!cached_games_.Find(url, &cached, [now](const CachedGames &games) {
+        return games.expires_at > now;
+      })) {
+    return false;
+  }
+  *matchups = std::move(cached.matchups);
+  return true;
+}
+
+void TeamFetcher::cache_games(const std::string &url,
+                              const std::vector<GameMatchup> &matchups) {
+  if (matchups.empty()) {
+    // Could be a failed call as well as a date without games.
+    return;
+  }
+  auto expires_at = Clock::time_point::max();
+  for (const auto &matchup : matchups) {
+    expires_at = std::min(expires_at, CacheExpiry(matchup.status(), live_ttl_));
+  }
+  if (expires_at <= Clock::now()) {
+    cached_games_.Erase(url);
+    return;
+  }
+  CachedGames cached;
+  cached.matchups = matchups;
+  cached.expires_at = expires_at;
+  // The url is charged along, it doesn't fit inside the string.
+  const size_t bytes = sizeof(CachedGames) +
+                       matchups.size() * sizeof(GameMatchup) + url.size() + 1;
+  cached_games_.Insert(url, cached, bytes);
+}
+
 std::string TeamFetcher::construct_endpoint_url(endpoint::Options *options) {
   // TODO: Maybe just have the kBaseUrl as non-static and build it inside the
   // constructor.
   const std::string version = options->version;
   const std::string season_start = options->season_start;
   const std::string date = options->date;
-  return replace(replace(replace(kBaseUrl, "<version>", version),
+  return replace(replace(replace(endpoint::resolve_base_url(kBaseUrl),
+                                 "<version>", version),
                          "<season-start>", season_start),
                  "<date>", date);
 }
@@ -2,8 +2,13 @@
 #define TEAM_FETCHER_H_
 
 #include "curl_fetch.h"
+#include "json_value.h"
+#include "single_flight.h"
+#include "symbol_table.h"
+#include "tiny_lfu_cache.h"
 #include "util.h"
-#include <nlohmann/json.hpp>
+#include <chrono>
+#include <future>
 #include <string>
 #include <vector>
 
@@ -11,48 +16,126 @@ namespace fantasy_ball {
 
 class TeamFetcher {
 public:
+  using Clock = std::chrono::steady_clock;
+
+  // Status of a game, from the playedStatus of its schedule.
+  enum class GameStatus {
+    kUnknown,
+    // Not started yet, e.g. the games of a future date.
+    kScheduled,
+    // Being played, or over but pending review.
+    kLive,
+    // The scores and stats won't change anymore.
+    kFinal,
+  };
+
   struct GameMatchup {
     GameMatchup() = default;
-    std::string home_team;
+    Symbol home_team;
     int home_team_id;
-    std::string away_team;
+    Symbol away_team;
     int away_team_id;
     int home_score;
     int away_score;
     int event_id;
 
-    static GameMatchup deserialize_json(const nlohmann::json &json_content) {
-      GameMatchup matchup = {};
-      matchup.event_id = -1;
-      if (!json_content.contains("schedule") ||
-          !json_content.contains("score")) {
-        return matchup;
-      }
-      const auto &schedule = json_content["schedule"];
-      const auto &score = json_content["score"];
-      matchup.home_team =
-          schedule["homeTeam"]["abbreviation"].get<std::string>();
-      matchup.home_team_id = schedule["homeTeam"]["id"].get<int>();
-      matchup.away_team =
-          schedule["awayTeam"]["abbreviation"].get<std::string>();
-      matchup.away_team_id = schedule["awayTeam"]["id"].get<int>();
-      matchup.home_score = score["homeScoreTotal"].get<int>();
-      matchup.away_score = score["awayScoreTotal"].get<int>();
-      matchup.event_id = schedule["id"].get<int>();
-      return matchup;
-    }
+    // e.g. COMPLETED, LIVE or UNPLAYED.
+    Symbol played_status;
+
+    // True when read from the last good games response, served while the
+    // endpoint was unavailable or being refreshed.
+    bool stale = false;
+
+    // Reads a games json item of the MySportsFeed games endpoint. The event id
+    // is -1 if the item has no schedule or score.
+    static GameMatchup deserialize_json(const JsonValue &json_content);
+
+    GameStatus status() const;
   };
   TeamFetcher(CurlFetch *curl_fetch);
   ~TeamFetcher();
 
+  // Returns until when data about a game with the given status, read now, can
+  // be cached: forever (Clock::time_point::max()) for final games, the live
+  // TTL for live games and games of unknown status, and not at all (now) for
+  // scheduled games.
+  static Clock::time_point CacheExpiry(GameStatus status,
+                                       std::chrono::milliseconds live_ttl);
+
+  // Sets how long the games of a date are cached while some of them are live,
+  // 30 seconds by default. Once every game is final, they're cached for good.
+  // NOTE: Should be set before the first fetch.
+  void SetLiveTtl(std::chrono::milliseconds live_ttl);
+
+  static const std::chrono::milliseconds kDefaultLiveTtl;
+
+  // Returns the games for the date of the options. Concurrent calls for the
+  // same games share a single endpoint call and its parsed matchups, unless
+  // the last good matchups can be served (marked stale) without waiting. Games
+  // are served from the cache until their earliest expiry (see CacheExpiry).
   std::vector<GameMatchup> GetGameReferences(endpoint::Options *options);
 
+  // Starts the games endpoint call without waiting for it, so that it can
+  // overlap with other endpoint calls. The response is parsed when the result
+  // is requested from the returned future.
+  std::future<std::vector<GameMatchup>>
+  GetGameReferencesAsync(endpoint::Options *options);
+
+  // Same as above, but the curl code of the games call is written to the
+  // given pointer when the result is requested from the returned future, so
+  // that a failed call can be told apart from a date without games. Error
+  // statuses are reported as CURLE_HTTP_RETURNED_ERROR.
+  std::future<std::vector<GameMatchup>>
+  GetGameReferencesAsync(endpoint::Options *options, CURLcode *curl_code);
+
 private:
   static const std::string kBaseUrl;
 
+  // Memory budget of the cached games, which covers the dates of a few
+  // seasons.
+  static const size_t kGamesCacheBytes;
+
+  // Games of a date along with the expiry of the earliest game to expire.
+  struct CachedGames {
+    CachedGames() = default;
+    std::vector<GameMatchup> matchups;
+    Clock::time_point expires_at;
+  };
+
+  // Returns the matchups of a games endpoint response. When the same body was
+  // already parsed (the endpoint confirmed that it didn't change, or a
+  // concurrent call shared the response), the previously parsed matchups are
+  // reused from the revalidation cache.
+  std::vector<GameMatchup>
+  read_game_references(const std::string &url,
+                       const CurlFetch::Response &response);
+
+  // Reads the games endpoint json content into a list of matchups.
+  static std::vector<GameMatchup>
+  parse_game_references(const std::string &content);
+
   // NOTE: This class doesn't have ownership of this object.
   CurlFetch *curl_fetch_;
 
+  // Game references retrievals that are in flight, keyed by endpoint url.
+  SingleFlight<std::string, std::vector<GameMatchup>> in_flight_;
+
+  std::chrono::milliseconds live_ttl_;
+
+  // Games that haven't expired yet (or did, until they're looked up again),
+  // keyed by endpoint url.
+  TinyLfuCache<std::string, CachedGames> cached_games_;
+
+  // Copies the cached games of the url. Returns false if there are none or
+  // they expired.
+  bool find_cached_games(const std::string &url,
+                         std::vector<GameMatchup> *matchups);
+
+  // Caches the games of the url until the earliest expiry among them. Nothing
+  // is cached if there are no games or one of them is scheduled.
+  void cache_games(const std::string &url,
+                   const std::vector<GameMatchup> &matchups);
+
   std::string construct_endpoint_url(endpoint::Options *options);
 };
 
@@ -0,0 +1,101 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <utility>
+
+namespace fantasy_ball {
+
+ThreadPool::ThreadPool(size_t thread_count) {
+  threads_.reserve(thread_count);
+  for (size_t i = 0; i < thread_count; ++i) {
+    threads_.emplace_back([this]() { work(); });
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  task_available_.notify_all();
+  for (auto &thread : threads_) {
+    thread.join();
+  }
+}
+
+void ThreadPool::Submit(std::function<void()> task) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    tasks_.push_back(std::move(task));
+  }
+  task_available_.notify_one();
+}
+
+void ThreadPool::ParallelFor(
+    size_t count, size_t chunk_size,
+    const std::function<void(size_t, size_t)> &run_chunk) {
+  chunk_size = std::max<size_t>(chunk_size, 1);
+  const size_t chunk_count = (count + chunk_size - 1) / chunk_size;
+  if (chunk_count == 0) {
+    return;
+  }
+  // NOTE: The helper tasks may only start once every chunk is done, after
+  // this call returned. The shared state outlives the call for them, and
+  // run_chunk is only called for chunks that this call waits on.
+  struct State {
+    std::atomic<size_t> next_chunk{0};
+    std::mutex mutex;
+    std::condition_variable chunks_done;
+    size_t done_count = 0;
+  };
+  auto state = std::make_shared<State>();
+  auto run_chunks = [state, count, chunk_size, chunk_count, &run_chunk]() {
+    size_t done = 0;
+    for (size_t chunk = state->next_chunk++; chunk < chunk_count;
+         chunk = state->next_chunk++) {
+      const size_t begin = chunk * chunk_size;
+      run_chunk(begin, std::min(count, begin + chunk_size));
+      ++done;
+    }
+    if (done == 0) {
+      return;
+    }
+    std::lock_guard<std::mutex> lock(state->mutex);
+    state->done_count += done;
+    if (state->done_count == chunk_count) {
+      state->chunks_done.notify_all();
+    }
+  };
+  const size_t helpers = std::min(threads_.size(), chunk_count - 1);
+  for (size_t i = 0; i < helpers; ++i) {
+    Submit(run_chunks);
+  }
+  run_chunks();
+  std::unique_lock<std::mutex> lock(state->mutex);
+  state->chunks_done.wait(lock, [&state, chunk_count]() {
+    return state->done_count == chunk_count;
+  });
+}
+
+size_t ThreadPool::size() const { return threads_.size(); }
+
+void ThreadPool::work() {
+  while (true) {
+    std::function<void()> task;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      task_available_.wait(lock,
+                           [this]() { return stopping_ || !tasks_.empty(); });
+      if (tasks_.empty()) {
+        return;
+      }
+      task = std::move(tasks_.front());
+      tasks_.pop_front();
+    }
+    task();
+  }
+}
+
+} // namespace fantasy_ball
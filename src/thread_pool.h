@@ -0,0 +1,50 @@
+#ifndef THREAD_POOL_H_
+#define THREAD_POOL_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace fantasy_ball {
+
+// Fixed set of worker threads running the submitted tasks in order, used to
+// spread the decoding of large responses over the cores.
+class ThreadPool {
+public:
+  explicit ThreadPool(size_t thread_count);
+
+  // Runs the tasks that are still queued, then joins the worker threads.
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  void Submit(std::function<void()> task);
+
+  // Splits [0, count) in consecutive chunks of chunk_size (the last one may be
+  // shorter) and calls run_chunk(begin, end) once for each of them, from the
+  // worker threads and the calling thread. Returns once every chunk ran.
+  // NOTE: The calling thread runs chunks too, so this can also be called from
+  // a task of the pool without waiting on itself.
+  void ParallelFor(size_t count, size_t chunk_size,
+                   const std::function<void(size_t, size_t)> &run_chunk);
+
+  size_t size() const;
+
+private:
+  std::mutex mutex_;
+  std::condition_variable task_available_;
+  std::deque<std::function<void()>> tasks_;
+  bool stopping_ = false;
+  std::vector<std::thread> threads_;
+
+  void work();
+};
+
+} // namespace fantasy_ball
+
+#endif // THREAD_POOL_H_
@@ -0,0 +1,277 @@
+#ifndef TINY_LFU_CACHE_H_
+#define TINY_LFU_CACHE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+#include "frequency_sketch.h"
+
+namespace fantasy_ball {
+
+// Counters of a TinyLfuCache.
+struct TinyLfuCacheStats {
+  TinyLfuCacheStats() = default;
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+
+  // Entries dropped to stay within the budget, including new entries that
+  // weren't admitted into the main space.
+  uint64_t evictions = 0;
+
+  size_t entries = 0;
+
+  // Memory charged for the entries, and the budget.
+  size_t bytes = 0;
+  size_t max_bytes = 0;
+};
+
+// Cache bounded by the memory of its entries, with W-TinyLFU eviction. New
+// entries go through a small LRU window (1% of the budget). Entries pushed out
+// of the window only stay in the main space if they were used more often than
+// the entry they'd replace, according to a frequency sketch of the recent
+// accesses. The main space is a segmented LRU: entries used again move from the
+// probation segment to the protected one (80% of the main space). A burst of
+// one-off entries (e.g. a backfill) can then only evict the window and each
+// other, instead of the frequently used ones.
+template <typename Key, typename Value, typename Hash = std::hash<Key>>
+class TinyLfuCache {
+public:
+  explicit TinyLfuCache(size_t max_bytes) { set_budget(max_bytes); }
+  ~TinyLfuCache() = default;
+
+  // Copies the value cached for the key. Returns false if there's none.
+  bool Find(const Key &key, Value *value) {
+    return Find(key, value, [](const Value &) { return true; });
+  }
+
+  // Same as above, but an entry whose value is_valid rejects (e.g. expired)
+  // is erased and counted as a miss.
+  template <typename Predicate>
+  bool Find(const Key &key, Value *value, Predicate is_valid) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    sketch_.Increment(hash_(key));
+    auto it = entries_.find(key);
+    if (it != entries_.end() && !is_valid(it->second.value)) {
+      remove(it);
+      it = entries_.end();
+    }
+    if (it == entries_.end()) {
+      ++stats_.misses;
+      return false;
+    }
+    ++stats_.hits;
+    touch(&it->second);
+    *value = it->second.value;
+    return true;
+  }
+
+  // Caches the value for the key, replacing any previous one. The bytes are
+  // the memory used by the value, including sizeof(Value); the bookkeeping of
+  // the entry is added to them. Values larger than the budget aren't cached.
+  void Insert(const Key &key, const Value &value, size_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    sketch_.Increment(hash_(key));
+    const size_t charge = bytes + kEntryOverhead;
+    auto it = entries_.find(key);
+    if (it != entries_.end() && charge <= max_bytes_) {
+      auto &slot = it->second;
+      region_bytes(slot.region) += charge;
+      region_bytes(slot.region) -= slot.charge;
+      slot.value = value;
+      slot.charge = charge;
+      touch(&slot);
+      evict();
+      return;
+    }
+    if (it != entries_.end()) {
+      remove(it);
+    }
+    if (charge > max_bytes_) {
+      return;
+    }
+    window_.push_front(key);
+    Slot slot = {value, charge, Region::kWindow, window_.begin()};
+    entries_.emplace(key, std::move(slot));
+    window_bytes_ += charge;
+    sketch_.EnsureCapacity(entries_.size());
+    evict();
+  }
+
+  // Drops the value cached for the key, if any.
+  void Erase(const Key &key) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(key);
+    if (it != entries_.end()) {
+      remove(it);
+    }
+  }
+
+  // Changes the budget, evicting entries if it's lower than the cached ones.
+  void SetMaxBytes(size_t max_bytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    set_budget(max_bytes);
+    evict();
+  }
+
+  TinyLfuCacheStats GetStats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    TinyLfuCacheStats stats = stats_;
+    stats.entries = entries_.size();
+    stats.bytes = window_bytes_ + probation_bytes_ + protected_bytes_;
+    stats.max_bytes = max_bytes_;
+    return stats;
+  }
+
+private:
+  enum class Region { kWindow, kProbation, kProtected };
+
+  struct Slot {
+    Value value;
+    size_t charge;
+    Region region;
+    typename std::list<Key>::iterator position;
+  };
+
+  using Entries = std::unordered_map<Key, Slot, Hash>;
+
+  // Approximate bookkeeping of an entry: the hash node (key, slot, next
+  // pointer and cached hash), its bucket and the list node (key and two
+  // pointers).
+  static constexpr size_t kEntryOverhead =
+      sizeof(Key) + sizeof(Slot) - sizeof(Value) + 3 * sizeof(void *) +
+      sizeof(size_t) + sizeof(Key) + 2 * sizeof(void *);
+
+  std::mutex mutex_;
+  Hash hash_;
+  Entries entries_;
+  FrequencySketch sketch_;
+
+  // Keys of each region, the most recently used ones at the front.
+  std::list<Key> window_;
+  std::list<Key> probation_;
+  std::list<Key> protected_;
+
+  size_t window_bytes_ = 0;
+  size_t probation_bytes_ = 0;
+  size_t protected_bytes_ = 0;
+
+  size_t max_bytes_ = 0;
+  size_t max_window_bytes_ = 0;
+  size_t max_main_bytes_ = 0;
+  size_t max_protected_bytes_ = 0;
+
+  TinyLfuCacheStats stats_;
+
+  void set_budget(size_t max_bytes) {
+    max_bytes_ = max_bytes;
+    max_window_bytes_ = max_bytes / 100;
+    max_main_bytes_ = max_bytes - max_window_bytes_;
+    max_protected_bytes_ = max_main_bytes_ / 5 * 4;
+  }
+
+  std::list<Key> &region_list(Region region) {
+    switch (region) {
+    case Region::kWindow:
+      return window_;
+    case Region::kProbation:
+      return probation_;
+    default:
+      return protected_;
+    }
+  }
+
+  size_t &region_bytes(Region region) {
+    switch (region) {
+    case Region::kWindow:
+      return window_bytes_;
+    case Region::kProbation:
+      return probation_bytes_;
+    default:
+      return protected_bytes_;
+    }
+  }
+
+  // Moves the entry to the front of the given region.
+  void move(Slot *slot, Region region) {
+    auto &from = region_list(slot->region);
+    auto &to = region_list(region);
+    to.splice(to.begin(), from, slot->position);
+    region_bytes(slot->region) -= slot->charge;
+    region_bytes(region) += slot->charge;
+    slot->region = region;
+  }
+
+  // Records a hit on the entry. Entries of the probation segment are
+  // promoted, which may demote the least recently used protected entries.
+  void touch(Slot *slot) {
+    if (slot->region != Region::kProbation) {
+      move(slot, slot->region);
+      return;
+    }
+    move(slot, Region::kProtected);
+    while (protected_bytes_ > max_protected_bytes_ && protected_.size() > 1) {
+      move(&entries_.find(protected_.back())->second, Region::kProbation);
+    }
+  }
+
+  void remove(typename Entries::iterator it) {
+    region_list(it->second.region).erase(it->second.position);
+    region_bytes(it->second.region) -= it->second.charge;
+    entries_.erase(it);
+  }
+
+  void drop(const Key &key) {
+    remove(entries_.find(key));
+    ++stats_.evictions;
+  }
+
+  // Returns true if the candidate, pushed out of the window, should replace
+  // the victim in the main space.
+  bool admit(const Key &candidate, const Key &victim) const {
+    return sketch_.Frequency(hash_(candidate)) >
+           sketch_.Frequency(hash_(victim));
+  }
+
+  void evict() {
+    while (window_bytes_ > max_window_bytes_ && !window_.empty()) {
+      const Key candidate = window_.back();
+      move(&entries_.find(candidate)->second, Region::kProbation);
+      while (probation_bytes_ + protected_bytes_ > max_main_bytes_) {
+        // The victim is the least recently used entry of the main space,
+        // besides the candidate.
+        const Key *victim = &probation_.back();
+        if (probation_.size() == 1) {
+          if (protected_.empty()) {
+            break;
+          }
+          victim = &protected_.back();
+        }
+        if (admit(candidate, *victim)) {
+          drop(Key(*victim));
+        } else {
+          drop(candidate);
+          break;
+        }
+      }
+    }
+    // e.g. the budget was lowered.
+    while (window_bytes_ + probation_bytes_ + protected_bytes_ > max_bytes_) {
+      if (!probation_.empty()) {
+        drop(Key(probation_.back()));
+      } else if (!protected_.empty()) {
+        drop(Key(protected_.back()));
+      } else {
+        drop(Key(window_.back()));
+      }
+    }
+  }
+};
+
+} // namespace fantasy_ball
+
+#endif // TINY_LFU_CACHE_H_
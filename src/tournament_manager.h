@@ -6,6 +6,8 @@
 #include <unordered_map>
 #include <vector>
 
+#include "symbol_table.h"
+
 namespace fantasy_ball {
 class TournamentManager {
 public:
@@ -64,12 +66,12 @@ public:
     // TODO: This is pretty much a copy of PlayerInfoShort. Might be better to
     // put this inside a common/util file.
     RosterMember() = default;
-    std::string first_name;
-    std::string last_name;
-    std::string team;
+    Symbol first_name;
+    Symbol last_name;
+    Symbol team;
     int player_id;
     int team_id;
-    std::string positions;
+    Symbol positions;
   };
 
   // Contains a short description of a player.
@@ -2,6 +2,9 @@
 
 #include <algorithm>
 #include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
 #include <curl/curl.h>
 #include <fstream>
 #include <random>
@@ -44,6 +47,35 @@ int int_or_negative(const std::string &word) {
   return std::stoi(word);
 }
 
+bool parse_int(const std::string &word, int64_t *value) {
+  if (word.empty()) {
+    return false;
+  }
+  char *end = nullptr;
+  errno = 0;
+  const long long parsed = std::strtoll(word.c_str(), &end, 10);
+  if (errno != 0 || end != word.c_str() + word.size()) {
+    return false;
+  }
+  *value = parsed;
+  return true;
+}
+
+bool parse_double(const std::string &word, double *value) {
+  if (word.empty()) {
+    return false;
+  }
+  char *end = nullptr;
+  errno = 0;
+  const double parsed = std::strtod(word.c_str(), &end);
+  if (errno != 0 || end != word.c_str() + word.size() ||
+      !std::isfinite(parsed)) {
+    return false;
+  }
+  *value = parsed;
+  return true;
+}
+
 std::vector<std::string> split(const std::string &str,
                                const std::string &delimiter) {
   size_t pos_start = 0, pos_end, delim_len = delimiter.length();
@@ -117,6 +149,15 @@ std::string base64_decode(const std::string &in) {
   return out;
 }
 
+uint64_t fnv1a_hash(const std::string &value) {
+  uint64_t hash = 14695981039346656037ULL;
+  for (unsigned char c : value) {
+    hash ^= c;
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
 // https://stackoverflow.com/questions/24365331/how-can-i-generate-uuid-in-c-without-using-boost-library
 std::string get_uuid() {
   static std::random_device dev;
@@ -145,13 +186,56 @@ std::string read_msf_api_key() {
   return api_key;
 }
 
+namespace {
+std::string &base_url_override() {
+  static std::string base_url;
+  return base_url;
+}
+} // namespace
+
+void set_msf_base_url(const std::string &base_url) {
+  base_url_override() = base_url;
+}
+
+std::string resolve_base_url(const std::string &url) {
+  std::string base_url = base_url_override();
+  if (base_url.empty()) {
+    const char *env_base_url = std::getenv(msf_base_url_env.c_str());
+    if (env_base_url != nullptr) {
+      base_url = env_base_url;
+    }
+  }
+  if (!base_url.empty() && base_url.back() == '/') {
+    base_url.pop_back();
+  }
+  if (base_url.empty()) {
+    return replace(replace(url, "<base>", msf_default_base_url),
+                   "<players-base>", msf_default_players_base_url);
+  }
+  return replace(replace(url, "<base>", base_url), "<players-base>", base_url);
+}
+
 void init_msf_curl_header(const std::string &api_key, CURL *curl_instance) {
+  curl_easy_setopt(curl_instance, CURLOPT_HTTPHEADER,
+                   make_msf_curl_header(api_key));
+}
+
+struct curl_slist *make_msf_curl_header(const std::string &api_key) {
   struct curl_slist *list = NULL;
   const std::string key_token =
       "Basic " + base64_encode(api_key + ":MYSPORTSFEEDS");
   const std::string auth_token = "Authorization: " + key_token;
   list = curl_slist_append(list, auth_token.c_str());
-  curl_easy_setopt(curl_instance, CURLOPT_HTTPHEADER, list);
+  return list;
+}
+
+std::string endpoint_name(const std::string &url) {
+  const std::string path = url.substr(0, url.find('?'));
+  const auto name_pos = path.rfind('/');
+  if (name_pos == std::string::npos) {
+    return path;
+  }
+  return path.substr(name_pos + 1);
 }
 } // namespace endpoint
 
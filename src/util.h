@@ -1,6 +1,7 @@
 #ifndef UTIL_H_
 #define UTIL_H_
 
+#include <cstdint>
 #include <curl/curl.h>
 #include <string>
 #include <vector>
@@ -22,6 +23,12 @@ float float_or_negative(const std::string &word);
 
 int int_or_negative(const std::string &word);
 
+// Parses the whole word as a base 10 integer or a finite number. Returns false
+// if the word is empty, has trailing characters or is out of range, the value
+// is then left unchanged.
+bool parse_int(const std::string &word, int64_t *value);
+bool parse_double(const std::string &word, double *value);
+
 std::vector<std::string> split(const std::string &str,
                                const std::string &delimiter = " ");
 
@@ -34,14 +41,45 @@ std::string base64_decode(const std::string &in);
 
 std::string get_uuid();
 
+// 64-bit FNV-1a hash, stable across runs and machines (unlike std::hash), e.g.
+// for file names and ETags.
+uint64_t fnv1a_hash(const std::string &value);
+
 namespace endpoint {
 // File path to file that contains mysportsfeeds api key.
 static const std::string msf_api_file_path = "config/mysportsfeeds_api_key.txt";
 
 std::string read_msf_api_key();
 
+// Base urls of the MySportsFeed endpoints, which replace the <base> and
+// <players-base> placeholders of the endpoint urls.
+static const std::string msf_default_base_url = "https://api.mysportsfeeds.com";
+static const std::string msf_default_players_base_url =
+    "https://scrambled-api.mysportsfeeds.com";
+
+// Environment variable overriding both base urls, e.g. to point the fetchers
+// to a local msf_stub_server (http://localhost:8089).
+static const std::string msf_base_url_env = "MSF_BASE_URL";
+
+// Overrides both base urls, takes precedence over the environment variable.
+// NOTE: Should be called before any endpoint url is built.
+void set_msf_base_url(const std::string &base_url);
+
+// Replaces the base url placeholders of the endpoint url with the base urls in
+// use.
+std::string resolve_base_url(const std::string &url);
+
 void init_msf_curl_header(const std::string &api_key, CURL *curl_instance);
 
+// Creates the header list with the authorization header for the MySportsFeed
+// endpoint. NOTE: The caller owns the list and should free it with
+// curl_slist_free_all once no handle uses it.
+struct curl_slist *make_msf_curl_header(const std::string &api_key);
+
+// Returns the name of the endpoint for the given url, which is the last part
+// of the path without the query. e.g. player_gamelogs.json
+std::string endpoint_name(const std::string &url);
+
 // Options for the various data fetchers.
 struct Options {
   Options() = default;
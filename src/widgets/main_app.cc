@@ -238,7 +238,8 @@ void FantasyApp::GetRoster(wxShowEvent &event) {
 
     // Create a label to display the player's name, team, and position.
     const std::string name_display =
-        fmt::format("{}. {}", description.first_name[0], description.last_name);
+        fmt::format("{}. {}", description.first_name.str()[0],
+                    description.last_name.str());
     wxStaticText *name_label = new wxStaticText(
         matchup_frame_->notebook_1_pane_1, wxID_ANY, wxString(name_display));
     name_label->SetFont(wxFont(18, wxFONTFAMILY_DEFAULT, wxFONTSTYLE_NORMAL,
@@ -252,7 +253,7 @@ void FantasyApp::GetRoster(wxShowEvent &event) {
     labels_sizer->Add(team_label, 0, wxALIGN_CENTER_VERTICAL, 0);
     wxStaticText *position_label =
         new wxStaticText(matchup_frame_->notebook_1_pane_1, wxID_ANY,
-                         wxString("- " + description.positions));
+                         wxString("- " + description.positions.str()));
     position_label->SetFont(wxFont(12, wxFONTFAMILY_DEFAULT, wxFONTSTYLE_NORMAL,
                                    wxFONTWEIGHT_NORMAL, 0, wxT("")));
     labels_sizer->Add(position_label, 0, wxALIGN_CENTER_VERTICAL, 0);